@@ -1,8 +1,10 @@
 #include "Drawler.h"
+#include "MeshNormal.h"
 
 #include <GLFW/glfw3.h>
 #include <GL/freeglut.h>
 #include <math.h>
+#include <string.h>
 
 Drawler::Drawler()
 {
@@ -40,45 +42,28 @@ void Drawler::CalculateNorm()
 
     for (const auto &m : tri)
     {
-        fPoint vector0{
-            m.v1.x - m.v0.x,
-            m.v1.y - m.v0.y,
-            m.v1.z - m.v0.z,
-        };
-
-        fPoint vector1{
-            m.v2.x - m.v0.x,
-            m.v2.y - m.v0.y,
-            m.v2.z - m.v0.z,
-        };
-
-        fPoint outerProduct{
-            vector0.y * vector1.z - vector0.z * vector1.y,
-            vector0.z * vector1.x - vector0.x * vector1.z,
-            vector0.x * vector1.y - vector0.y * vector1.x};
-
-        float distance = std::sqrt(outerProduct.x * outerProduct.x + outerProduct.y * outerProduct.y + outerProduct.z * outerProduct.z);
-
-        fPoint normVec{
-            outerProduct.x / distance,
-            outerProduct.y / distance,
-            outerProduct.z / distance};
-
-        // v0 norm
-        norm.emplace_back(normVec.x);
-        norm.emplace_back(normVec.y);
-        norm.emplace_back(normVec.z);
-
-        // v1 norm
-        norm.emplace_back(normVec.x);
-        norm.emplace_back(normVec.y);
-        norm.emplace_back(normVec.z);
-
-        // v2 norm
-        norm.emplace_back(normVec.x);
-        norm.emplace_back(normVec.y);
-        norm.emplace_back(normVec.z);
+        const fPoint normVec = MeshNormal::FaceNormal(m);
+
+        /** The face normal is given to its 3 vertices*/
+        for (int i = 0; i < 3; ++i)
+        {
+            norm.emplace_back(normVec.x);
+            norm.emplace_back(normVec.y);
+            norm.emplace_back(normVec.z);
+        }
+    }
+}
+
+bool Drawler::SetNorm(const std::vector<fPoint> &vertexNorm)
+{
+    if (vertexNorm.size() != tri.size() * 3)
+    {
+        return false;
     }
+
+    norm.resize(vertexNorm.size() * 3);
+    memcpy(norm.data(), vertexNorm.data(), vertexNorm.size() * sizeof(fPoint));
+    return true;
 }
 
 bool Drawler::CheckIsClose() const
@@ -250,7 +235,7 @@ void Drawler::GLDisplay()
 
     if (!norm.empty())
     {
-
+        glEnableClientState(GL_NORMAL_ARRAY);
         glNormalPointer(GL_FLOAT, 0, norm.data());
     }
 
@@ -260,6 +245,7 @@ void Drawler::GLDisplay()
 
     glDisableClientState(GL_VERTEX_ARRAY);
     glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
 }
 
 void Drawler::GLReshape()
@@ -282,4 +268,4 @@ void Drawler::RenderFrame()
     GLDisplay();
     glfwSwapBuffers(window);
     glfwPollEvents();
-}
\ No newline at end of file
+}
\ No newline at end of file
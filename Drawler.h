@@ -30,6 +30,8 @@ public:
     bool CheckIsClose() const;
 
     void CalculateNorm();
+    /** Per vertex normals instead of the face normals, 3 per triangle in the order of the mesh, false if the count does not match the mesh*/
+    bool SetNorm(const std::vector<fPoint> &);
     void RenderFrame();
 
 private:
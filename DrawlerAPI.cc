@@ -57,6 +57,13 @@ void CalculateNorm(const DRHandle handle)
     instanceMapping[handle]->CalculateNorm();
 }
 
+int SetNorm(const DRHandle handle, const fPoint *norm, const unsigned int normCount)
+{
+    std::vector<fPoint> normVec(normCount);
+    memcpy(normVec.data(), norm, normCount * sizeof(fPoint));
+    return static_cast<int>(instanceMapping[handle]->SetNorm(normVec));
+}
+
 void SetLightAmbiet(const DRHandle handle, const Color3 *color)
 {
     instanceMapping[handle]->SetLightAmbiet(*color);
@@ -32,6 +32,8 @@ extern "C"
     EXPORTDRAPI void SetMaterialDiffuse(const DRHandle, const Color3 *);
 
     EXPORTDRAPI void CalculateNorm(const DRHandle);
+    /** normals, normal count (3 per triangle, e.g. GetCurrentMeshVertexNormals of the normalized mesh), returns 0 if the count does not match the mesh*/
+    EXPORTDRAPI int SetNorm(const DRHandle, const fPoint *, const unsigned int);
     EXPORTDRAPI void RenderFrame(const DRHandle);
     EXPORTDRAPI int CheckIsClose(const DRHandle);
 
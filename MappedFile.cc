@@ -0,0 +1,138 @@
+#include "MappedFile.h"
+
+#include <filesystem>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() {}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open(const std::string &filename)
+{
+    Close();
+
+    const auto path = std::filesystem::absolute(filename).string();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == NULL)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    mappingHandle = mapping;
+    data = static_cast<const uint8_t *>(view);
+    size = static_cast<size_t>(fileSize.QuadPart);
+#else
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void *view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_SHARED, fd, 0);
+
+    /** The mapping keeps the file alive, the descriptor is not needed anymore*/
+    close(fd);
+
+    if (view == MAP_FAILED)
+    {
+        return false;
+    }
+
+    data = static_cast<const uint8_t *>(view);
+    size = static_cast<size_t>(fileStat.st_size);
+#endif
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (!data)
+    {
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+    CloseHandle(static_cast<HANDLE>(mappingHandle));
+    CloseHandle(static_cast<HANDLE>(fileHandle));
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    munmap(const_cast<uint8_t *>(data), size);
+#endif
+
+    data = nullptr;
+    size = 0;
+}
+
+void MappedFile::AdviseSequential() const
+{
+    if (!data)
+    {
+        return;
+    }
+
+#ifndef _WIN32
+    /** Windows has no madvise, the file is opened with FILE_FLAG_SEQUENTIAL_SCAN instead*/
+    madvise(const_cast<uint8_t *>(data), size, MADV_SEQUENTIAL);
+#endif
+}
+
+bool MappedFile::IsOpen() const
+{
+    return data != nullptr;
+}
+
+const uint8_t *MappedFile::Data() const
+{
+    return data;
+}
+
+size_t MappedFile::Size() const
+{
+    return size;
+}
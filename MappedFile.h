@@ -0,0 +1,41 @@
+#ifndef __MARCHING_CUBE_MAPPED_FILE_H__
+#define __MARCHING_CUBE_MAPPED_FILE_H__
+
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Read-only memory mapping of a whole file,
+ * every mapping of the same file shares the pages of the system page cache
+ */
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool Open(const std::string &);
+    void Close();
+
+    /** Tell the system the mapping will be read front to back*/
+    void AdviseSequential() const;
+
+    bool IsOpen() const;
+    const uint8_t *Data() const;
+    size_t Size() const;
+
+private:
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+
+#ifdef _WIN32
+    void *fileHandle = nullptr;
+    void *mappingHandle = nullptr;
+#endif
+};
+
+#endif
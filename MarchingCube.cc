@@ -1,233 +1,2602 @@
 #include "MarchingCube.h"
+#include "MeshWriter.h"
+#include "MeshNormal.h"
+#include "QuantizedMesh.h"
 #include "Table.h"
 
 #include <limits>
+#include <type_traits>
 #include <filesystem>
 #include <vector>
 #include <string>
 #include <fstream>
 #include <math.h>
+#include <string.h>
+#include <ctype.h>
 #include <regex>
 #include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+/** Edge cache slot without cross point*/
+#define EMPTY_EDGE 0xffffffffu
+
+/** Mask row not thresholded for any slice yet*/
+#define EMPTY_ROW 0xffffffffu
+
+/** Cubes per edge of a brick, a divisor of 64 so a brick is a whole byte range of a mask word*/
+#define BRICK_SIZE 8
+static_assert(64 % BRICK_SIZE == 0, "BRICK_SIZE must divide 64");
+
+/** Triangles handed to a mesh sink per call*/
+#define SINK_BATCH_TRIANGLES 8192u
+
+/** Bricks per edge of a mesh chunk*/
+#define MESH_CHUNK_BRICKS 4
+
+/** Vertices normalized by a thread at a time*/
+#define NORMALIZE_CHUNK_VERTICES (1u << 16)
+
+/** Face normals calculated by a thread at a time*/
+#define FACE_NORMAL_CHUNK_FACES (1u << 15)
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MC_SIMD_X86
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+    /**
+     * Call f with a point of the C++ type of a voxel type, so one generic lambda serves every type.
+     * An unknown type never gets here, the instance is not loaded then
+     */
+    template <typename F>
+    inline void VisitVoxelType(const unsigned int voxelType, F &&f)
+    {
+        switch (voxelType)
+        {
+        case VOXEL_UINT16:
+            f(uint16_t());
+            break;
+        case VOXEL_INT16:
+            f(int16_t());
+            break;
+        case VOXEL_FLOAT32:
+            f(float());
+            break;
+        default:
+            f(uint8_t());
+            break;
+        }
+    }
+
+    /** Integer points are below the isosurface exactly when they are below its ceiling, so they are compared in their own type*/
+    template <typename T>
+    inline T PointThreshold(const float isoSurface)
+    {
+        return std::is_integral<T>::value ? static_cast<T>(ceilf(isoSurface)) : static_cast<T>(isoSurface);
+    }
+
+    /** min/max of the points [first, last), a NaN point is never inside so it counts as above every isosurface*/
+    template <typename T>
+    inline void PointRange(const T *first, const T *last, float &outMin, float &outMax)
+    {
+        float low = std::numeric_limits<float>::infinity(), high = -low;
+        for (; first != last; ++first)
+        {
+            const float point = *first == *first ? static_cast<float>(*first) : std::numeric_limits<float>::infinity();
+            low = std::min(low, point);
+            high = std::max(high, point);
+        }
+        outMin = low;
+        outMax = high;
+    }
+
+    /** Scalar threshold of the points [begin, width) of a row, bit x of the mask is set if point x < threshold*/
+    template <typename T>
+    inline void ThresholdRowScalar(const T *row, const unsigned int begin, const unsigned int width, const T threshold, uint64_t *outMask)
+    {
+        for (unsigned int x = begin; x < width; x += 64)
+        {
+            const unsigned int end = std::min(width, x + 64);
+            uint64_t word = 0;
+            for (unsigned int i = x; i < end; ++i)
+            {
+                word |= static_cast<uint64_t>(row[i] < threshold) << (i - x);
+            }
+            outMask[x / 64] = word;
+        }
+    }
+
+#ifdef MC_SIMD_X86
+    inline __m128i SplatSSE2(const uint8_t threshold)
+    {
+        return _mm_set1_epi8(static_cast<char>(threshold));
+    }
+
+    inline __m128i SplatSSE2(const uint16_t threshold)
+    {
+        return _mm_set1_epi16(static_cast<short>(threshold));
+    }
+
+    inline __m128i SplatSSE2(const int16_t threshold)
+    {
+        return _mm_set1_epi16(threshold);
+    }
+
+    inline __m128 SplatSSE2(const float threshold)
+    {
+        return _mm_set1_ps(threshold);
+    }
+
+    /**
+     * The SSE2 thresholds make the inside bits of 16 points.
+     * threshold - point saturates to 0 exactly when point >= threshold,
+     * so the inside bits are the inverted movemask of (threshold -sat point) == 0
+     */
+    inline uint64_t ThresholdSSE2(const uint8_t *points, const __m128i threshold)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i point = _mm_loadu_si128(reinterpret_cast<const __m128i *>(points));
+        return static_cast<uint64_t>(~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_subs_epu8(threshold, point), zero)) & 0xffff);
+    }
+
+    /** The same saturation on 16 bit lanes, the two compares are packed to bytes in order for the movemask*/
+    inline uint64_t ThresholdSSE2(const uint16_t *points, const __m128i threshold)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(points));
+        const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(points + 8));
+        const __m128i outside = _mm_packs_epi16(
+            _mm_cmpeq_epi16(_mm_subs_epu16(threshold, low), zero),
+            _mm_cmpeq_epi16(_mm_subs_epu16(threshold, high), zero));
+        return static_cast<uint64_t>(~_mm_movemask_epi8(outside) & 0xffff);
+    }
+
+    inline uint64_t ThresholdSSE2(const int16_t *points, const __m128i threshold)
+    {
+        const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(points));
+        const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(points + 8));
+        return static_cast<uint64_t>(_mm_movemask_epi8(_mm_packs_epi16(_mm_cmplt_epi16(low, threshold), _mm_cmplt_epi16(high, threshold))));
+    }
+
+    /** An ordered compare, a NaN point is never inside*/
+    inline uint64_t ThresholdSSE2(const float *points, const __m128 threshold)
+    {
+        return static_cast<uint64_t>(_mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(points), threshold))) |
+               static_cast<uint64_t>(_mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(points + 4), threshold))) << 4 |
+               static_cast<uint64_t>(_mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(points + 8), threshold))) << 8 |
+               static_cast<uint64_t>(_mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(points + 12), threshold))) << 12;
+    }
+
+    /** SSE2 threshold, 64 points (one mask word) per step*/
+    template <typename T>
+    void ThresholdRowSSE2(const T *row, const unsigned int width, const T threshold, uint64_t *outMask)
+    {
+        const auto thresholdVec = SplatSSE2(threshold);
+
+        unsigned int x = 0;
+        for (; x + 64 <= width; x += 64)
+        {
+            outMask[x / 64] =
+                ThresholdSSE2(row + x, thresholdVec) |
+                ThresholdSSE2(row + x + 16, thresholdVec) << 16 |
+                ThresholdSSE2(row + x + 32, thresholdVec) << 32 |
+                ThresholdSSE2(row + x + 48, thresholdVec) << 48;
+        }
+        ThresholdRowScalar(row, x, width, threshold, outMask);
+    }
+
+#if defined(__GNUC__)
+#define MC_SIMD_AVX2
+
+    __attribute__((target("avx2"))) inline __m256i SplatAVX2(const uint8_t threshold)
+    {
+        return _mm256_set1_epi8(static_cast<char>(threshold));
+    }
+
+    __attribute__((target("avx2"))) inline __m256i SplatAVX2(const uint16_t threshold)
+    {
+        return _mm256_set1_epi16(static_cast<short>(threshold));
+    }
+
+    __attribute__((target("avx2"))) inline __m256i SplatAVX2(const int16_t threshold)
+    {
+        return _mm256_set1_epi16(threshold);
+    }
+
+    __attribute__((target("avx2"))) inline __m256 SplatAVX2(const float threshold)
+    {
+        return _mm256_set1_ps(threshold);
+    }
+
+    /** The AVX2 thresholds make the inside bits of 32 points, like the SSE2 ones*/
+    __attribute__((target("avx2"))) inline uint64_t ThresholdAVX2(const uint8_t *points, const __m256i threshold)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i point = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(points));
+        return static_cast<uint32_t>(~_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_subs_epu8(threshold, point), zero)));
+    }
+
+    /** The pack works within 128 bit lanes, the permute puts the 64 bit quarters back in point order*/
+    __attribute__((target("avx2"))) inline uint64_t ThresholdAVX2(const uint16_t *points, const __m256i threshold)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(points));
+        const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(points + 16));
+        const __m256i outside = _mm256_packs_epi16(
+            _mm256_cmpeq_epi16(_mm256_subs_epu16(threshold, low), zero),
+            _mm256_cmpeq_epi16(_mm256_subs_epu16(threshold, high), zero));
+        return static_cast<uint32_t>(~_mm256_movemask_epi8(_mm256_permute4x64_epi64(outside, 0xd8)));
+    }
+
+    __attribute__((target("avx2"))) inline uint64_t ThresholdAVX2(const int16_t *points, const __m256i threshold)
+    {
+        const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(points));
+        const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(points + 16));
+        const __m256i inside = _mm256_packs_epi16(_mm256_cmpgt_epi16(threshold, low), _mm256_cmpgt_epi16(threshold, high));
+        return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_permute4x64_epi64(inside, 0xd8)));
+    }
+
+    __attribute__((target("avx2"))) inline uint64_t ThresholdAVX2(const float *points, const __m256 threshold)
+    {
+        return static_cast<uint64_t>(_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(points), threshold, _CMP_LT_OQ))) |
+               static_cast<uint64_t>(_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(points + 8), threshold, _CMP_LT_OQ))) << 8 |
+               static_cast<uint64_t>(_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(points + 16), threshold, _CMP_LT_OQ))) << 16 |
+               static_cast<uint64_t>(_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(points + 24), threshold, _CMP_LT_OQ))) << 24;
+    }
+
+    /** AVX2 threshold, 64 points (one mask word) per step*/
+    template <typename T>
+    __attribute__((target("avx2"))) void ThresholdRowAVX2(const T *row, const unsigned int width, const T threshold, uint64_t *outMask)
+    {
+        const auto thresholdVec = SplatAVX2(threshold);
+
+        unsigned int x = 0;
+        for (; x + 64 <= width; x += 64)
+        {
+            outMask[x / 64] = ThresholdAVX2(row + x, thresholdVec) | ThresholdAVX2(row + x + 32, thresholdVec) << 32;
+        }
+        ThresholdRowScalar(row, x, width, threshold, outMask);
+    }
+
+    /** Checked once, the AVX2 kernel is only used on CPUs which support it*/
+    const bool isAVX2Supported = __builtin_cpu_supports("avx2");
+#endif
+#endif
+
+    /**
+     * Vertex normalization => every coordinate becomes coordinate * scale[axis] + offset[axis],
+     * the vertices [begin, end) of an xyz float stream, in and out may be the same stream
+     */
+    inline void NormalizeVerticesScalar(const float *in, float *out, const size_t begin, const size_t end, const float scale[3], const float offset[3])
+    {
+        for (size_t v = begin; v < end; ++v)
+        {
+            out[v * 3] = in[v * 3] * scale[0] + offset[0];
+            out[v * 3 + 1] = in[v * 3 + 1] * scale[1] + offset[1];
+            out[v * 3 + 2] = in[v * 3 + 2] * scale[2] + offset[2];
+        }
+    }
+
+#ifdef MC_SIMD_X86
+    /** SSE2 normalization, 4 vertices (3 registers of xyzx yzxy zxyz) per step*/
+    void NormalizeVerticesSSE2(const float *in, float *out, const size_t begin, const size_t end, const float scale[3], const float offset[3])
+    {
+        const __m128 scale0 = _mm_setr_ps(scale[0], scale[1], scale[2], scale[0]);
+        const __m128 scale1 = _mm_setr_ps(scale[1], scale[2], scale[0], scale[1]);
+        const __m128 scale2 = _mm_setr_ps(scale[2], scale[0], scale[1], scale[2]);
+        const __m128 offset0 = _mm_setr_ps(offset[0], offset[1], offset[2], offset[0]);
+        const __m128 offset1 = _mm_setr_ps(offset[1], offset[2], offset[0], offset[1]);
+        const __m128 offset2 = _mm_setr_ps(offset[2], offset[0], offset[1], offset[2]);
+
+        size_t v = begin;
+        for (; v + 4 <= end; v += 4)
+        {
+            const float *src = in + v * 3;
+            float *dst = out + v * 3;
+            const __m128 a = _mm_loadu_ps(src), b = _mm_loadu_ps(src + 4), c = _mm_loadu_ps(src + 8);
+            _mm_storeu_ps(dst, _mm_add_ps(_mm_mul_ps(a, scale0), offset0));
+            _mm_storeu_ps(dst + 4, _mm_add_ps(_mm_mul_ps(b, scale1), offset1));
+            _mm_storeu_ps(dst + 8, _mm_add_ps(_mm_mul_ps(c, scale2), offset2));
+        }
+        NormalizeVerticesScalar(in, out, v, end, scale, offset);
+    }
+
+#ifdef MC_SIMD_AVX2
+    /** AVX2 normalization, 8 vertices (3 registers of xyzxyzxy zxyzxyzx yzxyzxyz) per step, multiply then add like the scalar kernel*/
+    __attribute__((target("avx2"))) void NormalizeVerticesAVX2(const float *in, float *out, const size_t begin, const size_t end, const float scale[3], const float offset[3])
+    {
+        const __m256 scale0 = _mm256_setr_ps(scale[0], scale[1], scale[2], scale[0], scale[1], scale[2], scale[0], scale[1]);
+        const __m256 scale1 = _mm256_setr_ps(scale[2], scale[0], scale[1], scale[2], scale[0], scale[1], scale[2], scale[0]);
+        const __m256 scale2 = _mm256_setr_ps(scale[1], scale[2], scale[0], scale[1], scale[2], scale[0], scale[1], scale[2]);
+        const __m256 offset0 = _mm256_setr_ps(offset[0], offset[1], offset[2], offset[0], offset[1], offset[2], offset[0], offset[1]);
+        const __m256 offset1 = _mm256_setr_ps(offset[2], offset[0], offset[1], offset[2], offset[0], offset[1], offset[2], offset[0]);
+        const __m256 offset2 = _mm256_setr_ps(offset[1], offset[2], offset[0], offset[1], offset[2], offset[0], offset[1], offset[2]);
+
+        size_t v = begin;
+        for (; v + 8 <= end; v += 8)
+        {
+            const float *src = in + v * 3;
+            float *dst = out + v * 3;
+            const __m256 a = _mm256_loadu_ps(src), b = _mm256_loadu_ps(src + 8), c = _mm256_loadu_ps(src + 16);
+            _mm256_storeu_ps(dst, _mm256_add_ps(_mm256_mul_ps(a, scale0), offset0));
+            _mm256_storeu_ps(dst + 8, _mm256_add_ps(_mm256_mul_ps(b, scale1), offset1));
+            _mm256_storeu_ps(dst + 16, _mm256_add_ps(_mm256_mul_ps(c, scale2), offset2));
+        }
+        NormalizeVerticesScalar(in, out, v, end, scale, offset);
+    }
+#endif
+#endif
+
+    /**
+     * Face normals of the triangles [begin, end) => unit cross product of the edges leaving v0,
+     * a face whose squared cross product is not a normal float (no area, too small or NaN) gets (0, 0, 0).
+     * Returns the count of those faces
+     */
+    inline size_t FaceNormalsScalar(const Triangle *faces, fPoint *out, const size_t begin, const size_t end)
+    {
+        size_t degenerate = 0;
+        for (size_t i = begin; i < end; ++i)
+        {
+            const fPoint cross = MeshNormal::FaceCross(faces[i].v0, faces[i].v1, faces[i].v2);
+            const float lengthSquare = cross.x * cross.x + cross.y * cross.y + cross.z * cross.z;
+            if (lengthSquare >= std::numeric_limits<float>::min() && lengthSquare <= std::numeric_limits<float>::max())
+            {
+                const float inverse = 1 / sqrtf(lengthSquare);
+                out[i] = fPoint{cross.x * inverse, cross.y * inverse, cross.z * inverse};
+            }
+            else
+            {
+                out[i] = fPoint{0, 0, 0};
+                ++degenerate;
+            }
+        }
+        return degenerate;
+    }
+
+#ifdef MC_SIMD_X86
+    /** Set bits of a lane mask from movemask*/
+    inline unsigned int CountSetLanes(int mask)
+    {
+        unsigned int count = 0;
+        for (; mask; mask &= mask - 1)
+        {
+            ++count;
+        }
+        return count;
+    }
+
+    /** Store the normals of 4 faces from x, y and z registers as 12 packed floats*/
+    inline void StoreNormalsSSE2(__m128 x, __m128 y, __m128 z, fPoint *out)
+    {
+        __m128 w = _mm_setzero_ps();
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+
+        /** Each store spills one float over the next normal, which is written right after*/
+        float *dst = reinterpret_cast<float *>(out);
+        _mm_storeu_ps(dst, x);
+        _mm_storeu_ps(dst + 3, y);
+        _mm_storeu_ps(dst + 6, z);
+        float last[4];
+        _mm_storeu_ps(last, w);
+        memcpy(dst + 9, last, sizeof(fPoint));
+    }
+
+    /** SSE2 face normals, 4 faces per step, 1 / sqrt by rsqrt and one Newton step*/
+    size_t FaceNormalsSSE2(const Triangle *faces, fPoint *out, const size_t begin, const size_t end)
+    {
+        const __m128 half = _mm_set1_ps(0.5f), three = _mm_set1_ps(3.0f);
+        const __m128 lowest = _mm_set1_ps(std::numeric_limits<float>::min()), highest = _mm_set1_ps(std::numeric_limits<float>::max());
+
+        size_t degenerate = 0;
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4)
+        {
+            /** Gather the 9 coordinates of the 4 faces into one register each*/
+            const float *f = reinterpret_cast<const float *>(faces + i);
+            __m128 c[9];
+            for (int k = 0; k < 9; ++k)
+            {
+                c[k] = _mm_setr_ps(f[k], f[9 + k], f[18 + k], f[27 + k]);
+            }
+
+            const __m128 e0x = _mm_sub_ps(c[3], c[0]), e0y = _mm_sub_ps(c[4], c[1]), e0z = _mm_sub_ps(c[5], c[2]);
+            const __m128 e1x = _mm_sub_ps(c[6], c[0]), e1y = _mm_sub_ps(c[7], c[1]), e1z = _mm_sub_ps(c[8], c[2]);
+            const __m128 nx = _mm_sub_ps(_mm_mul_ps(e0y, e1z), _mm_mul_ps(e0z, e1y));
+            const __m128 ny = _mm_sub_ps(_mm_mul_ps(e0z, e1x), _mm_mul_ps(e0x, e1z));
+            const __m128 nz = _mm_sub_ps(_mm_mul_ps(e0x, e1y), _mm_mul_ps(e0y, e1x));
+            const __m128 lengthSquare = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz));
+
+            /** r = r0 * (3 - l * r0 * r0) / 2 takes the 12 bit estimate to about 23 bits*/
+            const __m128 r0 = _mm_rsqrt_ps(lengthSquare);
+            const __m128 r = _mm_mul_ps(_mm_mul_ps(half, r0), _mm_sub_ps(three, _mm_mul_ps(lengthSquare, _mm_mul_ps(r0, r0))));
+
+            /** NaN fails both comparisons, the normals of the degenerate lanes are zeroed (a NaN cross product times 0 is still NaN)*/
+            const __m128 valid = _mm_and_ps(_mm_cmpge_ps(lengthSquare, lowest), _mm_cmple_ps(lengthSquare, highest));
+            degenerate += 4 - CountSetLanes(_mm_movemask_ps(valid));
+
+            StoreNormalsSSE2(_mm_and_ps(_mm_mul_ps(nx, r), valid), _mm_and_ps(_mm_mul_ps(ny, r), valid), _mm_and_ps(_mm_mul_ps(nz, r), valid), out + i);
+        }
+        return degenerate + FaceNormalsScalar(faces, out, i, end);
+    }
+
+#ifdef MC_SIMD_AVX2
+    /** AVX2 face normals, 8 faces per step gathered from the triangles, same steps as the SSE2 kernel*/
+    __attribute__((target("avx2"))) size_t FaceNormalsAVX2(const Triangle *faces, fPoint *out, const size_t begin, const size_t end)
+    {
+        const __m256 half = _mm256_set1_ps(0.5f), three = _mm256_set1_ps(3.0f);
+        const __m256 lowest = _mm256_set1_ps(std::numeric_limits<float>::min()), highest = _mm256_set1_ps(std::numeric_limits<float>::max());
+        const __m256i faceOffsets = _mm256_setr_epi32(0, 9, 18, 27, 36, 45, 54, 63);
+
+        size_t degenerate = 0;
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8)
+        {
+            const float *f = reinterpret_cast<const float *>(faces + i);
+            __m256 c[9];
+            for (int k = 0; k < 9; ++k)
+            {
+                c[k] = _mm256_i32gather_ps(f + k, faceOffsets, 4);
+            }
+
+            const __m256 e0x = _mm256_sub_ps(c[3], c[0]), e0y = _mm256_sub_ps(c[4], c[1]), e0z = _mm256_sub_ps(c[5], c[2]);
+            const __m256 e1x = _mm256_sub_ps(c[6], c[0]), e1y = _mm256_sub_ps(c[7], c[1]), e1z = _mm256_sub_ps(c[8], c[2]);
+            const __m256 nx = _mm256_sub_ps(_mm256_mul_ps(e0y, e1z), _mm256_mul_ps(e0z, e1y));
+            const __m256 ny = _mm256_sub_ps(_mm256_mul_ps(e0z, e1x), _mm256_mul_ps(e0x, e1z));
+            const __m256 nz = _mm256_sub_ps(_mm256_mul_ps(e0x, e1y), _mm256_mul_ps(e0y, e1x));
+            const __m256 lengthSquare = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(ny, ny)), _mm256_mul_ps(nz, nz));
+
+            const __m256 r0 = _mm256_rsqrt_ps(lengthSquare);
+            const __m256 r = _mm256_mul_ps(_mm256_mul_ps(half, r0), _mm256_sub_ps(three, _mm256_mul_ps(lengthSquare, _mm256_mul_ps(r0, r0))));
+
+            const __m256 valid = _mm256_and_ps(_mm256_cmp_ps(lengthSquare, lowest, _CMP_GE_OQ), _mm256_cmp_ps(lengthSquare, highest, _CMP_LE_OQ));
+            degenerate += 8 - CountSetLanes(_mm256_movemask_ps(valid));
+
+            const __m256 x = _mm256_and_ps(_mm256_mul_ps(nx, r), valid), y = _mm256_and_ps(_mm256_mul_ps(ny, r), valid), z = _mm256_and_ps(_mm256_mul_ps(nz, r), valid);
+            StoreNormalsSSE2(_mm256_castps256_ps128(x), _mm256_castps256_ps128(y), _mm256_castps256_ps128(z), out + i);
+            StoreNormalsSSE2(_mm256_extractf128_ps(x, 1), _mm256_extractf128_ps(y, 1), _mm256_extractf128_ps(z, 1), out + i + 4);
+        }
+        return degenerate + FaceNormalsScalar(faces, out, i, end);
+    }
+#endif
+#endif
+
+    /** The bricks containing point p of an axis, the points on a brick boundary belong to both bricks*/
+    inline void PointBricks(const unsigned int p, const unsigned int brickCount, unsigned int &first, unsigned int &last)
+    {
+        last = std::min(p / BRICK_SIZE, brickCount - 1);
+        first = (p % BRICK_SIZE == 0 && p > 0) ? p / BRICK_SIZE - 1 : last;
+    }
+}
 
 MarchingCube::MarchingCube(const std::string &filename, const Dimension &dimension)
     : rawDimension(dimension)
 {
-    std::ifstream inFile(std::filesystem::absolute(filename).string(), std::ios::binary);
-    inFile.seekg(0, std::ios::end);
-    const auto filesize = inFile.tellg();
-    inFile.seekg(std::ios::beg);
-    rawBuffer.resize(dimension.width * dimension.height * dimension.depth);
-    inFile.read(reinterpret_cast<char *>(rawBuffer.data()), filesize);
-    inFile.close();
+    LoadFile(filename);
+}
+
+MarchingCube::MarchingCube(const std::string &filename, const Dimension &dimension, const bool isStreamingInput)
+    : rawDimension(dimension)
+{
+    if (!isStreamingInput)
+    {
+        LoadFile(filename);
+        return;
+    }
+
+    /** Only the size is checked here, the points are read by every March*/
+    voxelBytes = GetVoxelBytes(dimension.voxelType);
+    const size_t pointCount = static_cast<size_t>(dimension.width) * dimension.height * dimension.depth;
+    std::error_code error;
+    const auto fileSize = std::filesystem::file_size(filename, error);
+    if (voxelBytes == 0 || error || fileSize < pointCount * voxelBytes)
+    {
+        rawDimension = Dimension{0, 0, 0, VOXEL_UINT8};
+        return;
+    }
+
+    isStreaming = true;
+    rawFilename = filename;
+}
+
+void MarchingCube::LoadFile(const std::string &filename)
+{
+    /**
+     * March reads the points straight from the page cache,
+     * a file shorter than the dimension is rejected instead of being padded
+     */
+    voxelBytes = GetVoxelBytes(rawDimension.voxelType);
+    const size_t pointCount = static_cast<size_t>(rawDimension.width) * rawDimension.height * rawDimension.depth;
+    if (voxelBytes == 0 || !rawFile.Open(filename) || rawFile.Size() < pointCount * voxelBytes)
+    {
+        rawFile.Close();
+        rawDimension = Dimension{0, 0, 0, VOXEL_UINT8};
+        BuildBrickTree();
+        return;
+    }
+
+    rawFile.AdviseSequential();
+    rawData = rawFile.Data();
+
+    BuildBrickTree();
+}
+
+MarchingCube::MarchingCube(const std::vector<uint8_t> &buf, const Dimension &dimension)
+    : rawBuffer(buf), rawDimension(dimension)
+{
+    /** A buffer shorter than the dimension is rejected like a short file*/
+    voxelBytes = GetVoxelBytes(dimension.voxelType);
+    const size_t pointCount = static_cast<size_t>(dimension.width) * dimension.height * dimension.depth;
+    if (voxelBytes == 0 || rawBuffer.size() < pointCount * voxelBytes)
+    {
+        rawBuffer.clear();
+        rawDimension = Dimension{0, 0, 0, VOXEL_UINT8};
+        BuildBrickTree();
+        return;
+    }
+
+    rawData = rawBuffer.data();
+    BuildBrickTree();
+}
+
+MarchingCube::~MarchingCube() {}
+
+bool MarchingCube::IsLoaded() const
+{
+    return rawData != nullptr || isStreaming;
+}
+
+bool MarchingCube::IsStreaming() const
+{
+    return isStreaming;
+}
+
+unsigned int MarchingCube::GetVoxelType() const
+{
+    return rawDimension.voxelType;
+}
+
+unsigned int MarchingCube::GetVoxelBytes(const unsigned int voxelType)
+{
+    switch (voxelType)
+    {
+    case VOXEL_UINT8:
+        return 1;
+    case VOXEL_UINT16:
+    case VOXEL_INT16:
+        return 2;
+    case VOXEL_FLOAT32:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+void MarchingCube::March(const unsigned int inputIsoSurface)
+{
+    March(inputIsoSurface, 1);
+}
+
+void MarchingCube::March(const unsigned int inputIsoSurface, const unsigned int inputThreadCount)
+{
+    MarchValue(static_cast<float>(inputIsoSurface), inputThreadCount);
+}
+
+void MarchingCube::MarchValue(const float inputIsoSurface, const unsigned int inputThreadCount)
+{
+    currentIsoSurface = inputIsoSurface;
+    isCurrentMeshMarched = true;
+    ReleaseMeshChunks();
+
+    /** A level of one, the current mesh is swapped in and out so its storage is reused from march to march*/
+    std::vector<IndexedMesh> meshes(1);
+    std::swap(meshes[0], currentMesh);
+    MarchLevels({inputIsoSurface}, inputThreadCount, meshes);
+    std::swap(meshes[0], currentMesh);
+}
+
+void MarchingCube::MarchMulti(const std::vector<unsigned int> &isoSurfaces)
+{
+    MarchMulti(isoSurfaces, 1);
+}
+
+void MarchingCube::MarchMulti(const std::vector<unsigned int> &isoSurfaces, const unsigned int threadCount)
+{
+    MarchMultiValues(std::vector<float>(isoSurfaces.begin(), isoSurfaces.end()), threadCount);
+}
+
+void MarchingCube::MarchMultiValues(const std::vector<float> &isoSurfaces, const unsigned int threadCount)
+{
+    levelIsoSurfaces = isoSurfaces;
+    levelMeshes.resize(isoSurfaces.size());
+    MarchLevels(levelIsoSurfaces, threadCount, levelMeshes);
+}
+
+unsigned int MarchingCube::GetLevelCount() const
+{
+    return static_cast<unsigned int>(levelMeshes.size());
+}
+
+bool MarchingCube::GetLevelMesh(const unsigned int level, std::vector<Triangle> &outMesh) const
+{
+    if (level >= levelMeshes.size())
+    {
+        return false;
+    }
+    ExpandTriangles(levelMeshes[level].vertices, levelMeshes[level].indices, outMesh);
+    return true;
+}
+
+bool MarchingCube::GetLevelIndexedMesh(const unsigned int level, std::vector<fPoint> &outVertices, std::vector<unsigned int> &outIndices) const
+{
+    if (level >= levelMeshes.size())
+    {
+        return false;
+    }
+    outVertices = levelMeshes[level].vertices;
+    outIndices = levelMeshes[level].indices;
+    return true;
+}
+
+bool MarchingCube::GetLevelBoundingBox(const unsigned int level, fPoint &max, fPoint &min) const
+{
+    if (level >= levelMeshes.size())
+    {
+        return false;
+    }
+    max = levelMeshes[level].boundingBox[0];
+    min = levelMeshes[level].boundingBox[1];
+    return true;
+}
+
+bool MarchingCube::SelectLevel(const unsigned int level)
+{
+    if (level >= levelMeshes.size())
+    {
+        return false;
+    }
+    currentIsoSurface = levelIsoSurfaces[level];
+    currentMesh = levelMeshes[level];
+    isCurrentMeshMarched = true;
+    ReleaseMeshChunks();
+    return true;
+}
+
+void MarchingCube::MarchChunked(const unsigned int inputIsoSurface, const unsigned int threadCount)
+{
+    MarchChunkedValue(static_cast<float>(inputIsoSurface), threadCount);
+}
+
+void MarchingCube::MarchChunkedValue(const float inputIsoSurface, const unsigned int threadCount)
+{
+    currentIsoSurface = inputIsoSurface;
+    isCurrentMeshMarched = true;
+    ReleaseMeshChunks();
+
+    currentMesh = IndexedMesh();
+    currentMesh.boundingBox = EmptyBounding();
+
+    if (isStreaming || rawDimension.width < 2 || rawDimension.height < 2 || rawDimension.depth < 2)
+    {
+        return;
+    }
+
+    unsigned int chunksWidth, chunksHeight, chunksDepth;
+    GetChunkGridSize(chunksWidth, chunksHeight, chunksDepth);
+    meshChunks.resize(static_cast<size_t>(chunksWidth) * chunksHeight * chunksDepth);
+    hasMeshChunks = true;
+
+    /** Chunks of an isosurface no cube can be cut by are left empty*/
+    if (IsCuttable(inputIsoSurface))
+    {
+        MarchChunks(uPoint{0, 0, 0}, uPoint{chunksWidth - 1, chunksHeight - 1, chunksDepth - 1}, threadCount);
+    }
+    else
+    {
+        for (auto &chunk : meshChunks)
+        {
+            chunk.boundingBox = EmptyBounding();
+        }
+    }
+}
+
+unsigned int MarchingCube::GetChunkCount() const
+{
+    return hasMeshChunks ? static_cast<unsigned int>(meshChunks.size()) : 0;
+}
+
+bool MarchingCube::GetChunkRegion(const unsigned int chunk, uPoint &outFirst, Dimension &outSize) const
+{
+    if (chunk >= GetChunkCount())
+    {
+        return false;
+    }
+
+    unsigned int chunksWidth, chunksHeight, chunksDepth;
+    GetChunkGridSize(chunksWidth, chunksHeight, chunksDepth);
+    const CubeBox box = GetChunkBox(chunk % chunksWidth, chunk / chunksWidth % chunksHeight, chunk / chunksWidth / chunksHeight);
+
+    outFirst = uPoint{box.xBegin, box.yBegin, box.zBegin};
+    outSize = Dimension{box.xEnd - box.xBegin, box.yEnd - box.yBegin, box.zEnd - box.zBegin, rawDimension.voxelType};
+    return true;
+}
+
+bool MarchingCube::GetChunkIndexedMesh(const unsigned int chunk, std::vector<fPoint> &outVertices, std::vector<unsigned int> &outIndices) const
+{
+    if (chunk >= GetChunkCount())
+    {
+        return false;
+    }
+    outVertices = meshChunks[chunk].vertices;
+    outIndices = meshChunks[chunk].indices;
+    return true;
+}
+
+bool MarchingCube::GetChunkBoundingBox(const unsigned int chunk, fPoint &max, fPoint &min) const
+{
+    if (chunk >= GetChunkCount())
+    {
+        return false;
+    }
+    max = meshChunks[chunk].boundingBox[0];
+    min = meshChunks[chunk].boundingBox[1];
+    return true;
+}
+
+bool MarchingCube::GetChunkMeshSize(const unsigned int chunk, size_t &outVertexCount, size_t &outIndexCount) const
+{
+    if (chunk >= GetChunkCount())
+    {
+        return false;
+    }
+    outVertexCount = meshChunks[chunk].vertices.size();
+    outIndexCount = meshChunks[chunk].indices.size();
+    return true;
+}
+
+bool MarchingCube::IsChunkEmpty(const unsigned int chunk) const
+{
+    return chunk >= GetChunkCount() || meshChunks[chunk].indices.empty();
+}
+
+void MarchingCube::MarchLevels(const std::vector<float> &isoSurfaces, const unsigned int inputThreadCount, std::vector<IndexedMesh> &outMeshes)
+{
+    for (auto &mesh : outMeshes)
+    {
+        mesh.vertices.clear();
+        mesh.indices.clear();
+        mesh.normals.clear();
+        mesh.firstVertex = 0;
+        mesh.boundingBox = EmptyBounding();
+    }
+
+    if (rawDimension.width < 2 || rawDimension.height < 2 || rawDimension.depth < 2)
+    {
+        return;
+    }
+
+    /** Only the levels which can be cut are marched, the others are left empty*/
+    std::vector<unsigned int> levels;
+    for (unsigned int level = 0; level < isoSurfaces.size(); ++level)
+    {
+        if (IsCuttable(isoSurfaces[level]))
+        {
+            levels.emplace_back(level);
+        }
+    }
+    if (levels.empty())
+    {
+        return;
+    }
+
+    levelActiveBricks.resize(std::max(levelActiveBricks.size(), isoSurfaces.size()));
+    for (const auto level : levels)
+    {
+        PrepareBricks(isoSurfaces[level], levelActiveBricks[level]);
+    }
+
+    auto beginWalks = [&](const unsigned int zBegin, const unsigned int zEnd, std::vector<LayerWalk> &walks)
+    {
+        walks.resize(levels.size());
+        for (size_t i = 0; i < levels.size(); ++i)
+        {
+            BeginLayerWalk(GetVolumeBox(zBegin, zEnd), isoSurfaces[levels[i]], levelActiveBricks[levels[i]].data(), walks[i]);
+        }
+    };
+
+    const unsigned int cubeDepth = rawDimension.depth - 1;
+
+    if (isStreaming)
+    {
+        std::vector<LayerWalk> walks;
+        beginWalks(0, cubeDepth, walks);
+
+        std::vector<IndexedMesh *> meshes;
+        for (const auto level : levels)
+        {
+            meshes.emplace_back(&outMeshes[level]);
+        }
+
+        /** The file shrinking after the instance was made leaves no mesh rather than half of one*/
+        if (!WalkLayers(walks, meshes, nullptr))
+        {
+            for (auto *mesh : meshes)
+            {
+                mesh->vertices.clear();
+                mesh->indices.clear();
+                mesh->normals.clear();
+                mesh->boundingBox = EmptyBounding();
+            }
+        }
+        levelActiveBricks.clear();
+        return;
+    }
+
+    /** 0 means one thread per hardware core*/
+    unsigned int threadCount = inputThreadCount;
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threadCount = std::min(threadCount, cubeDepth);
+
+    if (threadCount == 1)
+    {
+        std::vector<LayerWalk> walks;
+        beginWalks(0, cubeDepth, walks);
+
+        std::vector<IndexedMesh *> meshes;
+        for (const auto level : levels)
+        {
+            meshes.emplace_back(&outMeshes[level]);
+        }
+        MarchSlab(0, cubeDepth, walks, meshes);
+        return;
+    }
+
+    /**
+     * Split the volume into z slabs, more slabs than threads
+     * so that a thread finishing a sparse slab can pick up another one.
+     * Every slab has its own indexed mesh per level, they are merged in slab order
+     * so the result is the same from run to run.
+     * The vertices on the slice between two slabs are made once by each slab,
+     * the merge keeps the ones of the lower slab so the mesh is the one marched by a thread.
+     */
+    const unsigned int slabCount = std::min(cubeDepth, threadCount * 4);
+    std::vector<std::vector<IndexedMesh>> slabMesh(slabCount, std::vector<IndexedMesh>(levels.size()));
+
+    /** The cut edges of the first and the last slice of every slab per level*/
+    std::vector<std::vector<SliceEdge>> firstSlices(slabCount * levels.size()), lastSlices(slabCount * levels.size());
+    std::atomic<unsigned int> nextSlab{0};
+
+    auto worker = [&]()
+    {
+        std::vector<LayerWalk> walks;
+        for (unsigned int slab = nextSlab++; slab < slabCount; slab = nextSlab++)
+        {
+            const unsigned int zBegin = static_cast<unsigned int>(static_cast<unsigned long long>(cubeDepth) * slab / slabCount);
+            const unsigned int zEnd = static_cast<unsigned int>(static_cast<unsigned long long>(cubeDepth) * (slab + 1) / slabCount);
+
+            std::vector<IndexedMesh *> meshes;
+            for (auto &mesh : slabMesh[slab])
+            {
+                mesh.boundingBox = EmptyBounding();
+                meshes.emplace_back(&mesh);
+            }
+
+            beginWalks(zBegin, zEnd, walks);
+
+            /** The first layer alone, its lower plane is reused by the next layer*/
+            MarchSlab(zBegin, zBegin + 1, walks, meshes);
+            if (slab > 0)
+            {
+                for (size_t i = 0; i < walks.size(); ++i)
+                {
+                    CollectSliceEdges(walks[i].edgeCache.planes[walks[i].edgeCache.lowerPlane], 0, firstSlices[slab * levels.size() + i]);
+                }
+            }
+
+            MarchSlab(zBegin + 1, zEnd, walks, meshes);
+            if (slab + 1 < slabCount)
+            {
+                for (size_t i = 0; i < walks.size(); ++i)
+                {
+                    const auto &edgeCache = walks[i].edgeCache;
+                    CollectSliceEdges(edgeCache.planes[1 - edgeCache.lowerPlane], edgeCache.upperStart, lastSlices[slab * levels.size() + i]);
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int i = 1; i < threadCount; ++i)
+    {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto &w : workers)
+    {
+        w.join();
+    }
+
+    for (size_t i = 0; i < levels.size(); ++i)
+    {
+        auto &levelMesh = outMeshes[levels[i]];
+
+        size_t vertexCount = 0, indexCount = 0;
+        for (const auto &slab : slabMesh)
+        {
+            vertexCount += slab[i].vertices.size();
+            indexCount += slab[i].indices.size();
+        }
+        levelMesh.vertices.reserve(vertexCount);
+        levelMesh.indices.reserve(indexCount);
+        if (isGradientNormals)
+        {
+            levelMesh.normals.reserve(vertexCount);
+        }
+
+        /** Index in the merged mesh of every vertex of the slab, of the previous slab for its last slice*/
+        std::vector<unsigned int> vertexMap, previousMap;
+        for (unsigned int slab = 0; slab < slabCount; ++slab)
+        {
+            auto &m = slabMesh[slab][i];
+            vertexMap.assign(m.vertices.size(), EMPTY_EDGE);
+
+            /** The edges of the first slice are matched to the ones of the last slice of the slab below, both in slot order*/
+            if (slab > 0)
+            {
+                const auto &upper = firstSlices[slab * levels.size() + i];
+                const auto &lower = lastSlices[(slab - 1) * levels.size() + i];
+                auto lowerEdge = lower.begin();
+                for (const auto &edge : upper)
+                {
+                    while (lowerEdge != lower.end() && lowerEdge->slot < edge.slot)
+                    {
+                        ++lowerEdge;
+                    }
+                    if (lowerEdge != lower.end() && lowerEdge->slot == edge.slot)
+                    {
+                        vertexMap[edge.vertex] = previousMap[lowerEdge->vertex];
+                    }
+                }
+            }
+
+            for (size_t v = 0; v < m.vertices.size(); ++v)
+            {
+                if (vertexMap[v] != EMPTY_EDGE)
+                {
+                    continue;
+                }
+                vertexMap[v] = static_cast<unsigned int>(levelMesh.vertices.size());
+                levelMesh.vertices.emplace_back(m.vertices[v]);
+                if (!m.normals.empty())
+                {
+                    levelMesh.normals.emplace_back(m.normals[v]);
+                }
+            }
+            for (const auto index : m.indices)
+            {
+                levelMesh.indices.emplace_back(vertexMap[index]);
+            }
+            std::swap(vertexMap, previousMap);
+
+            if (!m.vertices.empty())
+            {
+                CalculBounding(m.boundingBox[0], levelMesh.boundingBox);
+                CalculBounding(m.boundingBox[1], levelMesh.boundingBox);
+            }
+
+            m = IndexedMesh();
+        }
+    }
+}
+
+void MarchingCube::CollectSliceEdges(const std::vector<unsigned int> &plane, const unsigned int validStart, std::vector<SliceEdge> &outEdges)
+{
+    outEdges.clear();
+    for (size_t slot = 0; slot < plane.size(); ++slot)
+    {
+        if (plane[slot] != EMPTY_EDGE && plane[slot] >= validStart)
+        {
+            outEdges.emplace_back(SliceEdge{static_cast<unsigned int>(slot), plane[slot]});
+        }
+    }
+}
+
+void MarchingCube::MarchSlab(const unsigned int zBegin, const unsigned int zEnd, std::vector<LayerWalk> &walks, const std::vector<IndexedMesh *> &outMeshes) const
+{
+    /** Every level marches layer z while its two slices are still in the cache*/
+    for (unsigned int z = zBegin; z < zEnd; ++z)
+    {
+        for (size_t i = 0; i < walks.size(); ++i)
+        {
+            MarchLayer(z, walks[i], *outMeshes[i]);
+        }
+    }
+}
+
+bool MarchingCube::March(const unsigned int inputIsoSurface, MeshSink &sink)
+{
+    return MarchValue(static_cast<float>(inputIsoSurface), sink);
+}
+
+bool MarchingCube::MarchValue(const float inputIsoSurface, MeshSink &sink)
+{
+    currentIsoSurface = inputIsoSurface;
+    isCurrentMeshMarched = false;
+    ReleaseMeshChunks();
+    currentMesh.vertices.clear();
+    currentMesh.indices.clear();
+    currentMesh.normals.clear();
+    currentMesh.firstVertex = 0;
+    currentMesh.boundingBox = EmptyBounding();
+
+    if (rawDimension.width < 2 || rawDimension.height < 2 || rawDimension.depth < 2 || !IsCuttable(inputIsoSurface))
+    {
+        return true;
+    }
+
+    levelActiveBricks.resize(std::max<size_t>(levelActiveBricks.size(), 1));
+    PrepareBricks(inputIsoSurface, levelActiveBricks[0]);
+
+    std::vector<Triangle> batch;
+    batch.reserve(SINK_BATCH_TRIANGLES);
+
+    IndexedMesh layerMesh;
+    layerMesh.boundingBox = EmptyBounding();
+
+    auto handOut = [&](IndexedMesh &mesh, const LayerWalk &walk)
+    {
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+        {
+            batch.emplace_back(Triangle{
+                mesh.vertices[mesh.indices[i] - mesh.firstVertex],
+                mesh.vertices[mesh.indices[i + 1] - mesh.firstVertex],
+                mesh.vertices[mesh.indices[i + 2] - mesh.firstVertex]});
+
+            if (batch.size() == SINK_BATCH_TRIANGLES)
+            {
+                sink.Consume(batch.data(), batch.size());
+                batch.clear();
+            }
+        }
+        mesh.indices.clear();
+
+        /** The next layer only reuses the cross points on the upper slice of this layer, made after lowerStart*/
+        const unsigned int keptVertex = walk.edgeCache.lowerStart;
+        mesh.vertices.erase(mesh.vertices.begin(), mesh.vertices.begin() + (keptVertex - mesh.firstVertex));
+        mesh.firstVertex = keptVertex;
+    };
+
+    std::vector<LayerWalk> walks(1);
+    BeginLayerWalk(GetVolumeBox(0, rawDimension.depth - 1), inputIsoSurface, levelActiveBricks[0].data(), walks[0]);
+
+    /** The sink only receives triangles, normals would be made for nothing*/
+    walks[0].withNormals = false;
+
+    const bool isWalked = WalkLayers(walks, {&layerMesh}, handOut);
+    if (!batch.empty())
+    {
+        sink.Consume(batch.data(), batch.size());
+    }
+
+    if (isStreaming)
+    {
+        levelActiveBricks.clear();
+    }
+
+    currentMesh.boundingBox = layerMesh.boundingBox;
+    return isWalked;
+}
+
+bool MarchingCube::IsCuttable(const float isoSurface) const
+{
+    /** e.g. no 8 bit point is below 0 and every point is below 256, no cube can be cut. A NaN isosurface cuts nothing either*/
+    bool isCuttable = false;
+    VisitVoxelType(
+        rawDimension.voxelType,
+        [&](auto point)
+        {
+            using T = decltype(point);
+            if (std::is_integral<T>::value)
+            {
+                isCuttable = isoSurface > static_cast<float>(std::numeric_limits<T>::lowest()) &&
+                             isoSurface <= static_cast<float>(std::numeric_limits<T>::max());
+            }
+            else
+            {
+                isCuttable = std::isfinite(isoSurface);
+            }
+        });
+    return isCuttable;
+}
+
+void MarchingCube::PrepareBricks(const float isoSurface, std::vector<uint8_t> &outActive) const
+{
+    /** Nothing is skipped while streaming, the one brick layer is reused by every layer of cubes*/
+    if (isStreaming)
+    {
+        unsigned int bricksWidth, bricksHeight;
+        GetBrickLayerSize(bricksWidth, bricksHeight);
+        outActive.assign(static_cast<size_t>(bricksWidth) * bricksHeight, 1);
+        return;
+    }
+
+    outActive.assign(brickTree[0].min.size(), isBrickSkipping ? 0 : 1);
+    if (isBrickSkipping && hasSpanSpaceIndex)
+    {
+        CollectIndexedBricks(isoSurface, outActive);
+    }
+    else if (isBrickSkipping)
+    {
+        CollectActiveBricks(static_cast<unsigned int>(brickTree.size() - 1), 0, 0, 0, isoSurface, outActive);
+    }
+}
+
+bool MarchingCube::WalkLayers(std::vector<LayerWalk> &walks, const std::vector<IndexedMesh *> &outMeshes, const std::function<void(IndexedMesh &, const LayerWalk &)> &afterLayer)
+{
+    const size_t sliceBytes = static_cast<size_t>(rawDimension.width) * rawDimension.height * voxelBytes;
+    const unsigned int cubeDepth = rawDimension.depth - 1;
+
+    /** Gradient normals of slice z + 1 need slice z + 2, which is read one layer ahead*/
+    const bool withNormals = std::any_of(walks.begin(), walks.end(), [](const LayerWalk &walk)
+                                         { return walk.withNormals; });
+    const unsigned int readAhead = withNormals ? 2 : 1;
+
+    std::ifstream inFile;
+    unsigned int nextSlice = 0;
+    auto readSlices = [&](const unsigned int lastSlice)
+    {
+        for (; nextSlice <= lastSlice && nextSlice < rawDimension.depth; ++nextSlice)
+        {
+            inFile.read(reinterpret_cast<char *>(sliceWindow.data() + (nextSlice % sliceWindowSlots) * sliceBytes), static_cast<std::streamsize>(sliceBytes));
+            if (!inFile)
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    bool isRead = true;
+    if (isStreaming)
+    {
+        inFile.open(rawFilename, std::ios::binary);
+        sliceWindowSlots = withNormals ? 4 : 2;
+        sliceWindow.resize(sliceBytes * sliceWindowSlots);
+        isRead = readSlices(0);
+    }
+
+    /** The slice read for layer z overwrites a slice no layer needs anymore*/
+    for (unsigned int z = 0; isRead && z < cubeDepth; ++z)
+    {
+        if (isStreaming && !(isRead = readSlices(z + readAhead)))
+        {
+            break;
+        }
+
+        for (size_t i = 0; i < walks.size(); ++i)
+        {
+            MarchLayer(z, walks[i], *outMeshes[i]);
+            if (afterLayer)
+            {
+                afterLayer(*outMeshes[i], walks[i]);
+            }
+        }
+    }
+
+    if (isStreaming)
+    {
+        sliceWindow = std::vector<uint8_t>();
+    }
+    return isRead;
+}
+
+MarchingCube::CubeBox MarchingCube::GetVolumeBox(const unsigned int zBegin, const unsigned int zEnd) const
+{
+    return CubeBox{0, rawDimension.width - 1, 0, rawDimension.height - 1, zBegin, zEnd};
+}
+
+void MarchingCube::BeginLayerWalk(const CubeBox &box, const float isoSurface, const uint8_t *activeBricks, LayerWalk &walk) const
+{
+    /** The edge cache only covers the points of the box*/
+    walk.edgeCache.originX = box.xBegin;
+    walk.edgeCache.originY = box.yBegin;
+    walk.edgeCache.stride = box.xEnd - box.xBegin + 1;
+
+    const size_t slicePoints = static_cast<size_t>(walk.edgeCache.stride) * (box.yEnd - box.yBegin + 1);
+    walk.edgeCache.planes[0].assign(slicePoints * 2, EMPTY_EDGE);
+    walk.edgeCache.planes[1].assign(slicePoints * 2, EMPTY_EDGE);
+    walk.edgeCache.depthEdges.assign(slicePoints, EMPTY_EDGE);
+    walk.edgeCache.lowerStart = 0;
+
+    const size_t sliceWords = static_cast<size_t>(MaskWordsPerRow()) * rawDimension.height;
+    for (auto &mask : walk.sliceMasks)
+    {
+        mask.words.resize(sliceWords);
+        mask.rowSlice.assign(rawDimension.height, EMPTY_ROW);
+    }
+
+    walk.activeCubes.clear();
+    walk.box = box;
+    walk.isoSurface = isoSurface;
+    walk.withNormals = isGradientNormals;
+    walk.activeBricks = activeBricks;
+}
+
+void MarchingCube::MarchLayer(const unsigned int z, LayerWalk &walk, IndexedMesh &outMesh) const
+{
+    auto &edgeCache = walk.edgeCache;
+
+    /**
+     * Walk the layers of cubes in the same order as the raw memory layout, z => y => x.
+     * Each layer is classified by the inside masks of its two slices first,
+     * rows crossing no active brick are never thresholded nor classified,
+     * only the active cubes read their 8 values from the rows:
+     *  row00 => (y, z)     row01 => (y, z + 1)
+     *  row10 => (y + 1, z) row11 => (y + 1, z + 1)
+     *
+     * Cube vertices from Table::cubeVertices mapped to the rows:
+     *  v0 => row00[x]  v1 => row00[x + 1]  v2 => row01[x + 1]  v3 => row01[x]
+     *  v4 => row10[x]  v5 => row10[x + 1]  v6 => row11[x + 1]  v7 => row11[x]
+     */
+
+    /** The upper plane of the previous layer becomes the lower plane*/
+    edgeCache.lowerPlane = (z - walk.box.zBegin) % 2;
+    edgeCache.upperStart = outMesh.firstVertex + static_cast<unsigned int>(outMesh.vertices.size());
+
+    unsigned int bricksWidth, bricksHeight;
+    GetBrickLayerSize(bricksWidth, bricksHeight);
+    const size_t brickLayer = isStreaming ? 0 : z / BRICK_SIZE;
+    const uint8_t *layerBricks = walk.activeBricks + brickLayer * bricksHeight * bricksWidth;
+
+    walk.activeCubes.clear();
+    ClassifyLayer(z, walk.box, walk.isoSurface, layerBricks, walk.sliceMasks[edgeCache.lowerPlane], walk.sliceMasks[1 - edgeCache.lowerPlane], walk.activeCubes);
+
+    VisitVoxelType(
+        rawDimension.voxelType,
+        [&](auto point)
+        {
+            MarchActiveCubes<decltype(point)>(z, walk, outMesh);
+        });
+
+    /** The bounding box grows by the vertices of this layer, reduced once per layer while they are still in the cache*/
+    const size_t layerFirst = edgeCache.upperStart - outMesh.firstVertex;
+    ReduceBounding(outMesh.vertices.data() + layerFirst, outMesh.vertices.size() - layerFirst, outMesh.boundingBox);
+
+    edgeCache.lowerStart = edgeCache.upperStart;
+}
+
+template <typename T>
+void MarchingCube::MarchActiveCubes(const unsigned int z, LayerWalk &walk, IndexedMesh &outMesh) const
+{
+    for (const auto &cube : walk.activeCubes)
+    {
+        const unsigned int x = cube.x;
+        const T *row00 = GetRowPoints<T>(cube.y, z);
+        const T *row01 = GetRowPoints<T>(cube.y, z + 1);
+        const T *row10 = GetRowPoints<T>(cube.y + 1, z);
+        const T *row11 = GetRowPoints<T>(cube.y + 1, z + 1);
+
+        const float cubeVerticesValue[8] = {
+            static_cast<float>(row00[x]), static_cast<float>(row00[x + 1]), static_cast<float>(row01[x + 1]), static_cast<float>(row01[x]),
+            static_cast<float>(row10[x]), static_cast<float>(row10[x + 1]), static_cast<float>(row11[x + 1]), static_cast<float>(row11[x])};
+
+        CalculateMesh<T>(x, cube.y, z, cubeVerticesValue, cube.cubeIndex, walk.isoSurface, walk.withNormals, walk.edgeCache, outMesh);
+    }
+}
+
+void MarchingCube::GetBrickLayerSize(unsigned int &outWidth, unsigned int &outHeight) const
+{
+    /** Bricks of BRICK_SIZE cubes, the last brick of an axis may be smaller*/
+    outWidth = (rawDimension.width - 2) / BRICK_SIZE + 1;
+    outHeight = (rawDimension.height - 2) / BRICK_SIZE + 1;
+}
+
+unsigned int MarchingCube::MaskWordsPerRow() const
+{
+    return (rawDimension.width + 63) / 64;
+}
+
+void MarchingCube::ThresholdMaskRow(SliceMask &mask, const unsigned int y, const unsigned int z, const CubeBox &box, const float isoSurface) const
+{
+    if (mask.rowSlice[y] == z)
+    {
+        return;
+    }
+
+    /** The words of the cubes of the box and the word after them, which holds the point closing the last cube of a word*/
+    const unsigned int wordBegin = box.xBegin / 64;
+    const unsigned int pointEnd = std::min(rawDimension.width, ((box.xEnd - 1) / 64 + 2) * 64);
+
+    VisitVoxelType(
+        rawDimension.voxelType,
+        [&](auto point)
+        {
+            using T = decltype(point);
+            ThresholdRow(
+                GetRowPoints<T>(y, z) + wordBegin * 64,
+                pointEnd - wordBegin * 64,
+                PointThreshold<T>(isoSurface),
+                mask.words.data() + static_cast<size_t>(y) * MaskWordsPerRow() + wordBegin);
+        });
+    mask.rowSlice[y] = z;
+}
+
+void MarchingCube::ClassifyLayer(const unsigned int z, const CubeBox &box, const float isoSurface, const uint8_t *layerBricks, SliceMask &lowerMask, SliceMask &upperMask, std::vector<ActiveCube> &outActive) const
+{
+    const unsigned int wordsPerRow = MaskWordsPerRow();
+
+    unsigned int bricksWidth, bricksHeight;
+    GetBrickLayerSize(bricksWidth, bricksHeight);
+
+    /** Cubes of the active bricks of the current brick row, a brick is BRICK_SIZE bits of a word*/
+    std::vector<uint64_t> brickMask(wordsPerRow);
+    unsigned int brickMaskRow = EMPTY_ROW;
+    bool isBrickRowActive = false;
+
+    /** The boxes start on a brick boundary, so the bricks of the box cover exactly its cubes*/
+    const unsigned int bxBegin = box.xBegin / BRICK_SIZE;
+    const unsigned int bxEnd = (box.xEnd - 1) / BRICK_SIZE + 1;
+
+    for (unsigned int y = box.yBegin; y < box.yEnd; ++y)
+    {
+        if (y / BRICK_SIZE != brickMaskRow)
+        {
+            brickMaskRow = y / BRICK_SIZE;
+            std::fill(brickMask.begin(), brickMask.end(), 0);
+            isBrickRowActive = false;
+
+            const uint8_t *rowBricks = layerBricks + static_cast<size_t>(brickMaskRow) * bricksWidth;
+            for (unsigned int bx = bxBegin; bx < bxEnd; ++bx)
+            {
+                if (rowBricks[bx])
+                {
+                    const unsigned int firstCube = bx * BRICK_SIZE;
+                    brickMask[firstCube / 64] |= ((1ull << BRICK_SIZE) - 1) << (firstCube % 64);
+                    isBrickRowActive = true;
+                }
+            }
+        }
+
+        if (!isBrickRowActive)
+        {
+            continue;
+        }
+
+        ThresholdMaskRow(lowerMask, y, z, box, isoSurface);
+        ThresholdMaskRow(lowerMask, y + 1, z, box, isoSurface);
+        ThresholdMaskRow(upperMask, y, z + 1, box, isoSurface);
+        ThresholdMaskRow(upperMask, y + 1, z + 1, box, isoSurface);
+
+        const uint64_t *row00 = lowerMask.words.data() + static_cast<size_t>(y) * wordsPerRow;
+        const uint64_t *row10 = row00 + wordsPerRow;
+        const uint64_t *row01 = upperMask.words.data() + static_cast<size_t>(y) * wordsPerRow;
+        const uint64_t *row11 = row01 + wordsPerRow;
+
+        for (unsigned int w = box.xBegin / 64; w * 64 < box.xEnd; ++w)
+        {
+            if (!brickMask[w])
+            {
+                continue;
+            }
+
+            /** Bit x of r** => point x is inside, bit x of n** => point x + 1 is inside*/
+            const uint64_t r00 = row00[w], r01 = row01[w], r10 = row10[w], r11 = row11[w];
+            const bool hasNextWord = w + 1 < wordsPerRow;
+            const uint64_t n00 = (r00 >> 1) | (hasNextWord ? row00[w + 1] << 63 : 0);
+            const uint64_t n01 = (r01 >> 1) | (hasNextWord ? row01[w + 1] << 63 : 0);
+            const uint64_t n10 = (r10 >> 1) | (hasNextWord ? row10[w + 1] << 63 : 0);
+            const uint64_t n11 = (r11 >> 1) | (hasNextWord ? row11[w + 1] << 63 : 0);
+
+            /** A cube is cut if some of its 8 points are inside but not all of them*/
+            const uint64_t anyInside = r00 | n00 | r01 | n01 | r10 | n10 | r11 | n11;
+            const uint64_t allInside = r00 & n00 & r01 & n01 & r10 & n10 & r11 & n11;
+            uint64_t active = anyInside & ~allInside & brickMask[w];
+
+            /** The last point of a row or of the box starts no cube*/
+            const unsigned int cubesInWord = box.xEnd - w * 64;
+            if (cubesInWord < 64)
+            {
+                active &= (1ull << cubesInWord) - 1;
+            }
+
+            while (active)
+            {
+                const unsigned int bit = CountTrailingZeros(active);
+                active &= active - 1;
+
+                const unsigned int cubeIndex =
+                    static_cast<unsigned int>((r00 >> bit) & 1) |
+                    static_cast<unsigned int>((n00 >> bit) & 1) << 1 |
+                    static_cast<unsigned int>((n01 >> bit) & 1) << 2 |
+                    static_cast<unsigned int>((r01 >> bit) & 1) << 3 |
+                    static_cast<unsigned int>((r10 >> bit) & 1) << 4 |
+                    static_cast<unsigned int>((n10 >> bit) & 1) << 5 |
+                    static_cast<unsigned int>((n11 >> bit) & 1) << 6 |
+                    static_cast<unsigned int>((r11 >> bit) & 1) << 7;
+
+                outActive.emplace_back(ActiveCube{w * 64 + bit, y, cubeIndex});
+            }
+        }
+    }
+}
+
+/** Default isosurface*/
+void MarchingCube::March()
+{
+    March(DEFAULT_ISOSURFACE);
+}
+
+template <typename T>
+void MarchingCube::CalculateMesh(const unsigned int x, const unsigned int y, const unsigned int z, const float cubeVerticesValue[8], const unsigned int cubeIndex, const float isoSurface, const bool withNormals, EdgeCache &edgeCache, IndexedMesh &outMesh) const
+{
+    /**
+     * cubeVerticesValue => The Value of each 8 vertices of the cube
+     * cubeIndex => bit i is set if vertex i is inside the surface
+     */
+
+    /** Find which edges of the cube that mesh cut*/
+    unsigned int edges = Table::edgeTable[cubeIndex];
+
+    /** store the vertex index of the corss point of the edge of a cube, only the cut edges are written*/
+    unsigned int edgeCrossIndices[12];
+
+    /** Iterate over this 12 bits*/
+    for (int i = 0; i < 12; i++)
+    {
+        /** Bitwise "AND" these 12 bits*/
+        if (edges & (1 << i))
+        {
+            const unsigned int lowerVertex = Table::cubeEdgeOrigins[i][0];
+            const unsigned int upperVertex = Table::cubeEdgeOrigins[i][1];
+            const unsigned int axis = Table::cubeEdgeOrigins[i][2];
+
+            /** Find the cache slot of the edge by the point it starts from*/
+            const size_t point =
+                static_cast<size_t>(y + Table::cubeVertices[lowerVertex][1] - edgeCache.originY) * edgeCache.stride +
+                x + Table::cubeVertices[lowerVertex][0] - edgeCache.originX;
+
+            unsigned int *slot;
+            unsigned int slotStart;
+            if (axis == 2)
+            {
+                slot = &edgeCache.depthEdges[point];
+                slotStart = edgeCache.upperStart;
+            }
+            else if (Table::cubeVertices[lowerVertex][2] == 0)
+            {
+                slot = &edgeCache.planes[edgeCache.lowerPlane][point * 2 + axis];
+                slotStart = edgeCache.lowerStart;
+            }
+            else
+            {
+                slot = &edgeCache.planes[1 - edgeCache.lowerPlane][point * 2 + axis];
+                slotStart = edgeCache.upperStart;
+            }
+
+            /** The cross point has not been calculated by a neighbouring cube yet*/
+            if (*slot == EMPTY_EDGE || *slot < slotStart)
+            {
+                /** Calculate p1 (from raw data point to cube point)*/
+                uPoint p1{
+                    Table::cubeVertices[lowerVertex][0] + x,
+                    Table::cubeVertices[lowerVertex][1] + y,
+                    Table::cubeVertices[lowerVertex][2] + z,
+                };
+
+                uPoint p2{
+                    Table::cubeVertices[upperVertex][0] + x,
+                    Table::cubeVertices[upperVertex][1] + y,
+                    Table::cubeVertices[upperVertex][2] + z,
+                };
+
+                fPoint interpResult;
+                /** Interpolate
+                 * p1 = lower vertex of the edge
+                 * p2 = upper vertex of the edge
+                 * p1Val = value of p1
+                 * p2Val = value of p2
+                 */
+                const float ratio = VertexInterpolate(
+                    p1,
+                    p2,
+                    cubeVerticesValue[lowerVertex],
+                    cubeVerticesValue[upperVertex],
+                    isoSurface,
+                    interpResult);
+
+                *slot = outMesh.firstVertex + static_cast<unsigned int>(outMesh.vertices.size());
+                outMesh.vertices.emplace_back(interpResult);
+
+                if (withNormals)
+                {
+                    /** The triangles are wound to face the higher values, like the gradient*/
+                    float g1[3], g2[3];
+                    PointGradient<T>(p1, g1);
+                    PointGradient<T>(p2, g2);
+                    fPoint normal{
+                        g1[0] + ratio * (g2[0] - g1[0]),
+                        g1[1] + ratio * (g2[1] - g1[1]),
+                        g1[2] + ratio * (g2[2] - g1[2])};
+
+                    /** The differences around the edge may cancel out, the edge itself still crosses the surface*/
+                    if (normal.x == 0 && normal.y == 0 && normal.z == 0)
+                    {
+                        (&normal.x)[axis] = cubeVerticesValue[upperVertex] - cubeVerticesValue[lowerVertex];
+                    }
+                    outMesh.normals.emplace_back(MeshNormal::Unit(normal));
+                }
+            }
+
+            edgeCrossIndices[i] = *slot;
+        }
+    }
+    /**
+     * find connected triangle from given connectaion table
+     * iterate til the value is equal to -1
+     * The point is in times of 3 and will stop when it reaches -1.
+     * The number of this edge will be stored in the triTable.
+     * So
+     *  i   => v0 of the triangle
+     *  i+1 => v1 of the triangle
+     *  i+2 => v2 of the triangle
+     *
+     * The array of triangles repersenting Mesh
+     * */
+    for (int i = 0; Table::triTable[cubeIndex][i] != -1; i += 3)
+    {
+        outMesh.indices.emplace_back(edgeCrossIndices[Table::triTable[cubeIndex][i]]);
+        outMesh.indices.emplace_back(edgeCrossIndices[Table::triTable[cubeIndex][i + 1]]);
+        outMesh.indices.emplace_back(edgeCrossIndices[Table::triTable[cubeIndex][i + 2]]);
+    }
+}
+
+void MarchingCube::GetCurrentMesh(std::vector<Triangle> &outMesh) const
+{
+    const auto &mesh = CurrentMesh();
+    ExpandTriangles(mesh.vertices, mesh.indices, outMesh);
+}
+
+void MarchingCube::GetCurrentMeshNormalized(std::vector<Triangle> &outMesh) const
+{
+    GetCurrentMeshNormalized(outMesh, 1);
+}
+
+void MarchingCube::GetCurrentMeshNormalized(std::vector<Triangle> &outMesh, const unsigned int threadCount) const
+{
+    const auto &mesh = CurrentMesh();
+    std::vector<fPoint> normalizedVertices;
+    NormalizeVertices(mesh.vertices, normalizedVertices, threadCount);
+    ExpandTriangles(normalizedVertices, mesh.indices, outMesh);
+}
+
+void MarchingCube::GetCurrentIndexedMesh(std::vector<fPoint> &outVertices, std::vector<unsigned int> &outIndices) const
+{
+    const auto &mesh = CurrentMesh();
+    outVertices = mesh.vertices;
+    outIndices = mesh.indices;
+}
+
+void MarchingCube::GetCurrentIndexedMeshNormalized(std::vector<fPoint> &outVertices, std::vector<unsigned int> &outIndices) const
+{
+    GetCurrentIndexedMeshNormalized(outVertices, outIndices, 1);
+}
+
+void MarchingCube::GetCurrentIndexedMeshNormalized(std::vector<fPoint> &outVertices, std::vector<unsigned int> &outIndices, const unsigned int threadCount) const
+{
+    const auto &mesh = CurrentMesh();
+    NormalizeVertices(mesh.vertices, outVertices, threadCount);
+    outIndices = mesh.indices;
+}
+
+void MarchingCube::GetCurrentBoundingBox(fPoint &max, fPoint &min) const
+{
+    const auto &mesh = CurrentMesh();
+    max = mesh.boundingBox[0];
+    min = mesh.boundingBox[1];
+}
+
+bool MarchingCube::GetCurrentVertexNormals(std::vector<fPoint> &outNormals, const bool isNormalized) const
+{
+    const auto &mesh = CurrentMesh();
+    if (mesh.normals.size() != mesh.vertices.size() || mesh.vertices.empty())
+    {
+        return false;
+    }
+
+    if (isNormalized)
+    {
+        NormalizeNormals(mesh.normals, outNormals);
+    }
+    else
+    {
+        outNormals = mesh.normals;
+    }
+    return true;
+}
+
+bool MarchingCube::GetCurrentMeshVertexNormals(std::vector<fPoint> &outNormals, const bool isNormalized) const
+{
+    std::vector<fPoint> vertexNormals;
+    if (!GetCurrentVertexNormals(vertexNormals, isNormalized))
+    {
+        return false;
+    }
+
+    const auto &indices = CurrentMesh().indices;
+    outNormals.resize(indices.size());
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        outNormals[i] = vertexNormals[indices[i]];
+    }
+    return true;
+}
+
+void MarchingCube::NormalizeNormals(const std::vector<fPoint> &inNormals, std::vector<fPoint> &outNormals) const
+{
+    /**
+     * The vertices are scaled by 2 / extent per axis, the normals by the inverse transpose => extent / 2.
+     * An axis without extent was flattened, its component is kept as is
+     */
+    const auto &boundingBox = CurrentMesh().boundingBox;
+    const float extent[3] = {
+        boundingBox[0].x - boundingBox[1].x,
+        boundingBox[0].y - boundingBox[1].y,
+        boundingBox[0].z - boundingBox[1].z};
+
+    float scale[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        scale[axis] = extent[axis] > 0 ? extent[axis] / 2 : 1;
+    }
+
+    outNormals.resize(inNormals.size());
+    for (size_t i = 0; i < inNormals.size(); ++i)
+    {
+        const auto &n = inNormals[i];
+        outNormals[i] = MeshNormal::Unit(fPoint{n.x * scale[0], n.y * scale[1], n.z * scale[2]});
+    }
+}
+
+const MarchingCube::IndexedMesh &MarchingCube::CurrentMesh() const
+{
+    if (hasMeshChunks && !isChunkMeshAssembled)
+    {
+        AssembleMeshChunks();
+    }
+    return currentMesh;
+}
+
+void MarchingCube::NormalizeVertices(const std::vector<fPoint> &inVertices, std::vector<fPoint> &outVertices, const unsigned int inputThreadCount) const
+{
+    /**
+     * 2 * (v - min) / (max - min) - 1 => v * scale + offset, the divisions are made once per axis.
+     * An axis without extent has nothing to spread and maps to 0
+     */
+    const auto &boundingBox = CurrentMesh().boundingBox;
+    const float extent[3] = {
+        boundingBox[0].x - boundingBox[1].x,
+        boundingBox[0].y - boundingBox[1].y,
+        boundingBox[0].z - boundingBox[1].z};
+    const float lowest[3] = {boundingBox[1].x, boundingBox[1].y, boundingBox[1].z};
+
+    float scale[3], offset[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        scale[axis] = extent[axis] > 0 ? 2 / extent[axis] : 0;
+        offset[axis] = extent[axis] > 0 ? -lowest[axis] * scale[axis] - 1 : 0;
+    }
+
+    /** In place when the output is the input*/
+    if (&outVertices != &inVertices)
+    {
+        outVertices.resize(inVertices.size());
+    }
+
+    const float *in = reinterpret_cast<const float *>(inVertices.data());
+    float *out = reinterpret_cast<float *>(outVertices.data());
+    const size_t vertexCount = inVertices.size();
+
+    /** 0 means one thread per hardware core, a thread gets NORMALIZE_CHUNK_VERTICES at least*/
+    unsigned int threadCount = inputThreadCount;
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threadCount = static_cast<unsigned int>(std::max<size_t>(1, std::min<size_t>(threadCount, vertexCount / NORMALIZE_CHUNK_VERTICES)));
+
+    const size_t chunkCount = (vertexCount + NORMALIZE_CHUNK_VERTICES - 1) / NORMALIZE_CHUNK_VERTICES;
+    std::atomic<size_t> nextChunk{0};
+    auto worker = [&]()
+    {
+        for (size_t chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++)
+        {
+            const size_t begin = chunk * NORMALIZE_CHUNK_VERTICES;
+            NormalizeRange(in, out, begin, std::min(vertexCount, begin + NORMALIZE_CHUNK_VERTICES), scale, offset);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int i = 1; i < threadCount; ++i)
+    {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto &w : workers)
+    {
+        w.join();
+    }
+}
+
+void MarchingCube::NormalizeRange(const float *in, float *out, const size_t begin, const size_t end, const float scale[3], const float offset[3])
+{
+#if defined(MC_SIMD_AVX2)
+    if (isAVX2Supported)
+    {
+        NormalizeVerticesAVX2(in, out, begin, end, scale, offset);
+        return;
+    }
+#endif
+#if defined(MC_SIMD_X86)
+    NormalizeVerticesSSE2(in, out, begin, end, scale, offset);
+#else
+    NormalizeVerticesScalar(in, out, begin, end, scale, offset);
+#endif
+}
+
+void MarchingCube::NormalizeCurrentMesh(const unsigned int threadCount)
+{
+    /** The chunks keep the volume coordinates, the normalized mesh is flat and no longer follows the patches*/
+    CurrentMesh();
+    ReleaseMeshChunks();
+    isCurrentMeshMarched = false;
+
+    if (currentMesh.vertices.empty())
+    {
+        return;
+    }
+
+    NormalizeNormals(currentMesh.normals, currentMesh.normals);
+
+    NormalizeVertices(currentMesh.vertices, currentMesh.vertices, threadCount);
+
+    /** The max corner maps to 1 and the min corner to -1, an axis without extent maps to 0*/
+    fPoint &highest = currentMesh.boundingBox[0];
+    fPoint &lowest = currentMesh.boundingBox[1];
+    const bool hasExtent[3] = {highest.x > lowest.x, highest.y > lowest.y, highest.z > lowest.z};
+    highest = fPoint{hasExtent[0] ? 1.0f : 0.0f, hasExtent[1] ? 1.0f : 0.0f, hasExtent[2] ? 1.0f : 0.0f};
+    lowest = fPoint{hasExtent[0] ? -1.0f : 0.0f, hasExtent[1] ? -1.0f : 0.0f, hasExtent[2] ? -1.0f : 0.0f};
+}
+
+void MarchingCube::ExpandTriangles(const std::vector<fPoint> &vertices, const std::vector<unsigned int> &indices, std::vector<Triangle> &outMesh)
+{
+    outMesh.resize(indices.size() / 3);
+
+    for (size_t i = 0; i < outMesh.size(); i++)
+    {
+        outMesh[i] = Triangle{
+            vertices[indices[i * 3]],
+            vertices[indices[i * 3 + 1]],
+            vertices[indices[i * 3 + 2]]};
+    }
+}
+
+float MarchingCube::GetPointData(const unsigned int width, const unsigned int height, const unsigned int depth) const
+{
+    float value = 0;
+    VisitVoxelType(
+        rawDimension.voxelType,
+        [&](auto point)
+        {
+            value = static_cast<float>(GetRowPoints<decltype(point)>(height, depth)[width]);
+        });
+    return value;
+}
+
+void MarchingCube::BuildBrickTree()
+{
+    brickTree.clear();
+
+    /** An empty node, no isosurface is between its min and max*/
+    const float emptyMin = std::numeric_limits<float>::infinity(), emptyMax = -emptyMin;
+
+    if (rawDimension.width < 2 || rawDimension.height < 2 || rawDimension.depth < 2)
+    {
+        brickTree.emplace_back(BrickLevel{1, 1, 1, {emptyMin}, {emptyMax}});
+        return;
+    }
+
+    BrickLevel bricks;
+    GetBrickLayerSize(bricks.width, bricks.height);
+    bricks.depth = (rawDimension.depth - 2) / BRICK_SIZE + 1;
+    bricks.min.assign(static_cast<size_t>(bricks.width) * bricks.height * bricks.depth, emptyMin);
+    bricks.max.assign(bricks.min.size(), emptyMax);
+
+    /** min/max of the BRICK_SIZE + 1 points of every brick along a row*/
+    std::vector<float> rowMin(bricks.width), rowMax(bricks.width);
+
+    for (unsigned int z = 0; z < rawDimension.depth; ++z)
+    {
+        unsigned int bzFirst, bzLast;
+        PointBricks(z, bricks.depth, bzFirst, bzLast);
+
+        for (unsigned int y = 0; y < rawDimension.height; ++y)
+        {
+            unsigned int byFirst, byLast;
+            PointBricks(y, bricks.height, byFirst, byLast);
+
+            VisitVoxelType(
+                rawDimension.voxelType,
+                [&](auto point)
+                {
+                    const auto *row = GetRowPoints<decltype(point)>(y, z);
+                    for (unsigned int bx = 0; bx < bricks.width; ++bx)
+                    {
+                        const unsigned int xEnd = std::min((bx + 1) * BRICK_SIZE, rawDimension.width - 1);
+                        PointRange(row + bx * BRICK_SIZE, row + xEnd + 1, rowMin[bx], rowMax[bx]);
+                    }
+                });
+
+            for (unsigned int bz = bzFirst; bz <= bzLast; ++bz)
+            {
+                for (unsigned int by = byFirst; by <= byLast; ++by)
+                {
+                    const size_t offset = (static_cast<size_t>(bz) * bricks.height + by) * bricks.width;
+                    for (unsigned int bx = 0; bx < bricks.width; ++bx)
+                    {
+                        bricks.min[offset + bx] = std::min(bricks.min[offset + bx], rowMin[bx]);
+                        bricks.max[offset + bx] = std::max(bricks.max[offset + bx], rowMax[bx]);
+                    }
+                }
+            }
+        }
+    }
+
+    brickTree.emplace_back(std::move(bricks));
+
+    /** Merge 2x2x2 nodes until a single root is left*/
+    while (brickTree.back().width > 1 || brickTree.back().height > 1 || brickTree.back().depth > 1)
+    {
+        const auto &child = brickTree.back();
+
+        BrickLevel parent;
+        parent.width = (child.width + 1) / 2;
+        parent.height = (child.height + 1) / 2;
+        parent.depth = (child.depth + 1) / 2;
+        parent.min.assign(static_cast<size_t>(parent.width) * parent.height * parent.depth, emptyMin);
+        parent.max.assign(parent.min.size(), emptyMax);
+
+        for (unsigned int z = 0; z < child.depth; ++z)
+        {
+            for (unsigned int y = 0; y < child.height; ++y)
+            {
+                for (unsigned int x = 0; x < child.width; ++x)
+                {
+                    const size_t childIndex = (static_cast<size_t>(z) * child.height + y) * child.width + x;
+                    const size_t parentIndex = (static_cast<size_t>(z / 2) * parent.height + y / 2) * parent.width + x / 2;
+                    parent.min[parentIndex] = std::min(parent.min[parentIndex], child.min[childIndex]);
+                    parent.max[parentIndex] = std::max(parent.max[parentIndex], child.max[childIndex]);
+                }
+            }
+        }
+
+        brickTree.emplace_back(std::move(parent));
+    }
+}
+
+void MarchingCube::CollectActiveBricks(const unsigned int level, const unsigned int x, const unsigned int y, const unsigned int z, const float isoSurface, std::vector<uint8_t> &outActive) const
+{
+    const auto &node = brickTree[level];
+    const size_t index = (static_cast<size_t>(z) * node.height + y) * node.width + x;
+
+    /** A cube is cut only if one of its points is below the isosurface and another is not*/
+    if (!(node.min[index] < isoSurface && node.max[index] >= isoSurface))
+    {
+        return;
+    }
+
+    if (level == 0)
+    {
+        outActive[index] = 1;
+        return;
+    }
+
+    const auto &child = brickTree[level - 1];
+    for (unsigned int cz = z * 2; cz < std::min(z * 2 + 2, child.depth); ++cz)
+    {
+        for (unsigned int cy = y * 2; cy < std::min(y * 2 + 2, child.height); ++cy)
+        {
+            for (unsigned int cx = x * 2; cx < std::min(x * 2 + 2, child.width); ++cx)
+            {
+                CollectActiveBricks(level - 1, cx, cy, cz, isoSurface, outActive);
+            }
+        }
+    }
+}
+
+bool MarchingCube::BuildSpanSpaceIndex(const size_t memoryBudget)
+{
+    ReleaseSpanSpaceIndex();
+
+    /** The finest level of the brick tree whose index fits the budget*/
+    const size_t bucketBytes = 257 * sizeof(unsigned int);
+    const size_t nodeBytes = sizeof(unsigned int) + sizeof(float);
+
+    /** One bucket per 8 bit value, per 256 values of 16 bit, the range of the volume split in 256 for float*/
+    spanSpaceIndex.bucketLow = 0;
+    spanSpaceIndex.bucketScale = 0;
+    VisitVoxelType(
+        rawDimension.voxelType,
+        [&](auto point)
+        {
+            using T = decltype(point);
+            if (std::is_integral<T>::value)
+            {
+                spanSpaceIndex.bucketLow = static_cast<float>(std::numeric_limits<T>::lowest());
+                spanSpaceIndex.bucketScale = 256.0f / (static_cast<float>(std::numeric_limits<T>::max()) - spanSpaceIndex.bucketLow + 1);
+                return;
+            }
+
+            const float low = brickTree.back().min[0], high = brickTree.back().max[0];
+            if (std::isfinite(high - low) && high > low)
+            {
+                spanSpaceIndex.bucketLow = low;
+                spanSpaceIndex.bucketScale = 256.0f / (high - low);
+            }
+        });
+
+    for (unsigned int level = 0; level < brickTree.size(); ++level)
+    {
+        const auto &nodeLevel = brickTree[level];
+
+        size_t nodeCount = 0;
+        for (size_t i = 0; i < nodeLevel.min.size(); ++i)
+        {
+            nodeCount += nodeLevel.min[i] != nodeLevel.max[i];
+        }
+
+        if (bucketBytes + nodeCount * nodeBytes > memoryBudget)
+        {
+            continue;
+        }
+
+        /** Counting sort by min, then sort every bucket by max from high to low*/
+        spanSpaceIndex.level = level;
+        spanSpaceIndex.bucketOffsets.assign(257, 0);
+        for (size_t i = 0; i < nodeLevel.min.size(); ++i)
+        {
+            if (nodeLevel.min[i] != nodeLevel.max[i])
+            {
+                ++spanSpaceIndex.bucketOffsets[SpanBucket(nodeLevel.min[i]) + 1];
+            }
+        }
+        for (unsigned int m = 0; m < 256; ++m)
+        {
+            spanSpaceIndex.bucketOffsets[m + 1] += spanSpaceIndex.bucketOffsets[m];
+        }
+
+        spanSpaceIndex.nodes.resize(nodeCount);
+        std::vector<unsigned int> bucketFill(spanSpaceIndex.bucketOffsets.begin(), spanSpaceIndex.bucketOffsets.end() - 1);
+        for (size_t i = 0; i < nodeLevel.min.size(); ++i)
+        {
+            if (nodeLevel.min[i] != nodeLevel.max[i])
+            {
+                spanSpaceIndex.nodes[bucketFill[SpanBucket(nodeLevel.min[i])]++] = static_cast<unsigned int>(i);
+            }
+        }
+
+        for (unsigned int m = 0; m < 256; ++m)
+        {
+            std::sort(
+                spanSpaceIndex.nodes.begin() + spanSpaceIndex.bucketOffsets[m],
+                spanSpaceIndex.nodes.begin() + spanSpaceIndex.bucketOffsets[m + 1],
+                [&nodeLevel](const unsigned int a, const unsigned int b)
+                {
+                    return nodeLevel.max[a] > nodeLevel.max[b] || (nodeLevel.max[a] == nodeLevel.max[b] && a < b);
+                });
+        }
+
+        spanSpaceIndex.nodeMax.resize(nodeCount);
+        for (size_t i = 0; i < nodeCount; ++i)
+        {
+            spanSpaceIndex.nodeMax[i] = nodeLevel.max[spanSpaceIndex.nodes[i]];
+        }
+
+        hasSpanSpaceIndex = true;
+        spanSpaceBudget = memoryBudget;
+        return true;
+    }
+
+    return false;
+}
+
+void MarchingCube::ReleaseSpanSpaceIndex()
+{
+    spanSpaceIndex = SpanSpaceIndex();
+    hasSpanSpaceIndex = false;
+}
+
+size_t MarchingCube::GetSpanSpaceIndexMemory() const
+{
+    return spanSpaceIndex.bucketOffsets.size() * sizeof(unsigned int) +
+           spanSpaceIndex.nodes.size() * sizeof(unsigned int) +
+           spanSpaceIndex.nodeMax.size() * sizeof(float);
+}
+
+unsigned int MarchingCube::SpanBucket(const float value) const
+{
+    const float bucket = floorf((value - spanSpaceIndex.bucketLow) * spanSpaceIndex.bucketScale);
+    if (!(bucket > 0))
+    {
+        return 0;
+    }
+    return bucket >= 255 ? 255 : static_cast<unsigned int>(bucket);
+}
+
+void MarchingCube::CollectIndexedBricks(const float isoSurface, std::vector<uint8_t> &outActive) const
+{
+    const auto &nodeLevel = brickTree[spanSpaceIndex.level];
+
+    /**
+     * The bucket of the highest value below the isosurface is the last one holding nodes cut by it,
+     * CollectActiveBricks skips its nodes whose min is not below the isosurface
+     */
+    const float belowIso = rawDimension.voxelType == VOXEL_FLOAT32 ? isoSurface : ceilf(isoSurface) - 1;
+    const unsigned int lastBucket = SpanBucket(belowIso);
+
+    for (unsigned int m = 0; m <= lastBucket; ++m)
+    {
+        for (unsigned int i = spanSpaceIndex.bucketOffsets[m]; i < spanSpaceIndex.bucketOffsets[m + 1]; ++i)
+        {
+            /** The rest of the bucket is entirely below the isosurface*/
+            if (spanSpaceIndex.nodeMax[i] < isoSurface)
+            {
+                break;
+            }
+
+            const unsigned int node = spanSpaceIndex.nodes[i];
+            const unsigned int x = node % nodeLevel.width;
+            const unsigned int y = (node / nodeLevel.width) % nodeLevel.height;
+            const unsigned int z = node / nodeLevel.width / nodeLevel.height;
+            CollectActiveBricks(spanSpaceIndex.level, x, y, z, isoSurface, outActive);
+        }
+    }
+}
+
+bool MarchingCube::PatchVolume(const uPoint &first, const Dimension &size, const uint8_t *points)
+{
+    if (isStreaming || !rawData || size.width == 0 || size.height == 0 || size.depth == 0 ||
+        first.x >= rawDimension.width || size.width > rawDimension.width - first.x ||
+        first.y >= rawDimension.height || size.height > rawDimension.height - first.y ||
+        first.z >= rawDimension.depth || size.depth > rawDimension.depth - first.z)
+    {
+        return false;
+    }
+
+    /** The mapping is read only, the points are copied into memory before the first write*/
+    if (rawData != rawBuffer.data())
+    {
+        rawBuffer.assign(rawData, rawData + static_cast<size_t>(rawDimension.width) * rawDimension.height * rawDimension.depth * voxelBytes);
+        rawData = rawBuffer.data();
+        rawFile.Close();
+    }
+
+    for (unsigned int z = 0; z < size.depth; ++z)
+    {
+        for (unsigned int y = 0; y < size.height; ++y)
+        {
+            const size_t offset = (static_cast<size_t>(first.z + z) * rawDimension.height + first.y + y) * rawDimension.width + first.x;
+            memcpy(
+                rawBuffer.data() + offset * voxelBytes,
+                points + (static_cast<size_t>(z) * size.height + y) * size.width * voxelBytes,
+                static_cast<size_t>(size.width) * voxelBytes);
+        }
+    }
+
+    const uPoint last{first.x + size.width - 1, first.y + size.height - 1, first.z + size.depth - 1};
+    UpdateBrickTree(first, last);
+
+    /** The index may no longer fit the budget, it is left released then*/
+    if (hasSpanSpaceIndex)
+    {
+        BuildSpanSpaceIndex(spanSpaceBudget);
+    }
+
+    if (!isCurrentMeshMarched || !IsCuttable(currentIsoSurface) ||
+        rawDimension.width < 2 || rawDimension.height < 2 || rawDimension.depth < 2)
+    {
+        return true;
+    }
+
+    /**
+     * The first patch after a march splits the whole mesh into chunks on every core,
+     * the next ones only re-march the chunks they touch
+     */
+    unsigned int chunksWidth, chunksHeight, chunksDepth;
+    GetChunkGridSize(chunksWidth, chunksHeight, chunksDepth);
+    if (!hasMeshChunks)
+    {
+        meshChunks.resize(static_cast<size_t>(chunksWidth) * chunksHeight * chunksDepth);
+        MarchChunks(uPoint{0, 0, 0}, uPoint{chunksWidth - 1, chunksHeight - 1, chunksDepth - 1}, 0);
+        hasMeshChunks = true;
+    }
+    else
+    {
+        /**
+         * Cube c has the points c and c + 1, the cubes around point p are p - 1 and p. The gradient normals of cube c
+         * also read the points c - 1 and c + 2, so with them the cubes p - 2 .. p + 1 see point p
+         */
+        const unsigned int chunkCubes = MESH_CHUNK_BRICKS * BRICK_SIZE;
+        const unsigned int reachBefore = isGradientNormals ? 2 : 1;
+        const unsigned int reachAfter = isGradientNormals ? 1 : 0;
+        auto chunkRange = [chunkCubes, reachBefore, reachAfter](const unsigned int pFirst, const unsigned int pLast, const unsigned int pointCount, unsigned int &outFirst, unsigned int &outLast)
+        {
+            outFirst = (pFirst > reachBefore ? pFirst - reachBefore : 0) / chunkCubes;
+            outLast = std::min(pLast + reachAfter, pointCount - 2) / chunkCubes;
+        };
+
+        uPoint chunkFirst, chunkLast;
+        chunkRange(first.x, last.x, rawDimension.width, chunkFirst.x, chunkLast.x);
+        chunkRange(first.y, last.y, rawDimension.height, chunkFirst.y, chunkLast.y);
+        chunkRange(first.z, last.z, rawDimension.depth, chunkFirst.z, chunkLast.z);
+        MarchChunks(chunkFirst, chunkLast, 0);
+    }
+
+    /** The current mesh is assembled again when it is asked for*/
+    isChunkMeshAssembled = false;
+    return true;
 }
 
-MarchingCube::MarchingCube(const std::vector<uint8_t> &buf, const Dimension &dimension)
-    : rawBuffer(buf), rawDimension(dimension)
+void MarchingCube::GetChunkGridSize(unsigned int &outWidth, unsigned int &outHeight, unsigned int &outDepth) const
 {
+    const auto &bricks = brickTree[0];
+    outWidth = (bricks.width + MESH_CHUNK_BRICKS - 1) / MESH_CHUNK_BRICKS;
+    outHeight = (bricks.height + MESH_CHUNK_BRICKS - 1) / MESH_CHUNK_BRICKS;
+    outDepth = (bricks.depth + MESH_CHUNK_BRICKS - 1) / MESH_CHUNK_BRICKS;
 }
 
-MarchingCube::~MarchingCube() {}
+MarchingCube::CubeBox MarchingCube::GetChunkBox(const unsigned int x, const unsigned int y, const unsigned int z) const
+{
+    const unsigned int chunkCubes = MESH_CHUNK_BRICKS * BRICK_SIZE;
+    return CubeBox{
+        x * chunkCubes, std::min((x + 1) * chunkCubes, rawDimension.width - 1),
+        y * chunkCubes, std::min((y + 1) * chunkCubes, rawDimension.height - 1),
+        z * chunkCubes, std::min((z + 1) * chunkCubes, rawDimension.depth - 1)};
+}
 
-void MarchingCube::March(const unsigned int inputIsoSurface)
+void MarchingCube::MarchChunks(const uPoint &first, const uPoint &last, const unsigned int inputThreadCount)
 {
-    currentIsoSurface = inputIsoSurface;
-    currentMesh.clear();
-    currentBoundingBox =
+    unsigned int chunksWidth, chunksHeight, chunksDepth;
+    GetChunkGridSize(chunksWidth, chunksHeight, chunksDepth);
+    chunkEdges.resize(meshChunks.size());
+
+    const auto &bricks = brickTree[0];
+    std::vector<uint8_t> activeBricks;
+    PrepareBricks(currentIsoSurface, activeBricks);
+
+    /** A chunk without an active brick has nothing to march*/
+    auto isChunkActive = [&](const CubeBox &box)
+    {
+        for (unsigned int bz = box.zBegin / BRICK_SIZE; bz * BRICK_SIZE < box.zEnd; ++bz)
+        {
+            for (unsigned int by = box.yBegin / BRICK_SIZE; by * BRICK_SIZE < box.yEnd; ++by)
+            {
+                const uint8_t *rowBricks = activeBricks.data() + (static_cast<size_t>(bz) * bricks.height + by) * bricks.width;
+                if (std::any_of(rowBricks + box.xBegin / BRICK_SIZE, rowBricks + (box.xEnd - 1) / BRICK_SIZE + 1, [](const uint8_t b)
+                                { return b != 0; }))
+                {
+                    return true;
+                }
+            }
+        }
+        return false;
+    };
+
+    std::vector<uPoint> chunks;
+    for (unsigned int cz = first.z; cz <= last.z; ++cz)
+    {
+        for (unsigned int cy = first.y; cy <= last.y; ++cy)
         {
-            fPoint{
-                std::numeric_limits<float>::min(),
-                std::numeric_limits<float>::min(),
-                std::numeric_limits<float>::min()},
-            fPoint{
-                std::numeric_limits<float>::max(),
-                std::numeric_limits<float>::max(),
-                std::numeric_limits<float>::max()}};
+            for (unsigned int cx = first.x; cx <= last.x; ++cx)
+            {
+                chunks.emplace_back(uPoint{cx, cy, cz});
+            }
+        }
+    }
 
-    for (unsigned int i = 0; i < rawDimension.width - 1; ++i)
+    /** 0 means one thread per hardware core*/
+    unsigned int threadCount = inputThreadCount;
+    if (threadCount == 0)
     {
-        for (unsigned int j = 0; j < rawDimension.height - 1; ++j)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threadCount = static_cast<unsigned int>(std::max<size_t>(1, std::min<size_t>(threadCount, chunks.size())));
+
+    /** Every chunk has its own vertices, the cross points on a chunk boundary are made by both chunks and welded by AssembleMeshChunks*/
+    std::atomic<size_t> nextChunk{0};
+    auto worker = [&]()
+    {
+        LayerWalk walk;
+        for (size_t i = nextChunk++; i < chunks.size(); i = nextChunk++)
         {
-            for (unsigned int k = 0; k < rawDimension.depth - 1; ++k)
+            const auto &c = chunks[i];
+            const size_t chunkIndex = (static_cast<size_t>(c.z) * chunksHeight + c.y) * chunksWidth + c.x;
+            auto &chunk = meshChunks[chunkIndex];
+            auto &edges = chunkEdges[chunkIndex];
+            edges.clear();
+            chunk.vertices.clear();
+            chunk.indices.clear();
+            chunk.normals.clear();
+            chunk.firstVertex = 0;
+            chunk.boundingBox = EmptyBounding();
+
+            const CubeBox box = GetChunkBox(c.x, c.y, c.z);
+            if (!isChunkActive(box))
             {
-                CalculateMesh(i, j, k);
+                continue;
             }
+
+            BeginLayerWalk(box, currentIsoSurface, activeBricks.data(), walk);
+            for (unsigned int z = box.zBegin; z < box.zEnd; ++z)
+            {
+                /** MarchLayer moves lowerStart on to the next slice*/
+                const unsigned int sliceStart = walk.edgeCache.lowerStart;
+                MarchLayer(z, walk, chunk);
+                CollectChunkEdges(z, walk, sliceStart, edges);
+            }
+
+            /** Sorted, so the edges two chunks share are matched by one walk over both*/
+            std::sort(edges.begin(), edges.end(), [](const ChunkEdge &a, const ChunkEdge &b)
+                      { return a.edge < b.edge; });
         }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int i = 1; i < threadCount; ++i)
+    {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto &w : workers)
+    {
+        w.join();
     }
 }
 
-/** Default isosurface*/
-void MarchingCube::March()
+void MarchingCube::CollectChunkEdges(const unsigned int z, const LayerWalk &walk, const unsigned int sliceStart, std::vector<ChunkEdge> &outEdges) const
 {
-    March(DEFAULT_ISOSURFACE);
+    const auto &edgeCache = walk.edgeCache;
+    const auto &box = walk.box;
+
+    /** The faces on the border of the volume have no neighbour*/
+    const bool hasLowerX = box.xBegin > 0, hasUpperX = box.xEnd < rawDimension.width - 1;
+    const bool hasLowerY = box.yBegin > 0, hasUpperY = box.yEnd < rawDimension.height - 1;
+    const bool hasLowerZ = z == box.zBegin && box.zBegin > 0;
+    const bool hasUpperZ = z + 1 == box.zEnd && box.zEnd < rawDimension.depth - 1;
+
+    auto collect = [&](const unsigned int vertex, const unsigned int validStart, const unsigned int x, const unsigned int y, const unsigned int pz, const unsigned int axis)
+    {
+        if (vertex != EMPTY_EDGE && vertex >= validStart)
+        {
+            const uint64_t point = (static_cast<uint64_t>(pz) * rawDimension.height + y) * rawDimension.width + x;
+            outEdges.emplace_back(ChunkEdge{point * 3 + axis, vertex});
+        }
+    };
+
+    /** x edges lie on the y faces, y edges on the x faces and z edges on both, the x and y edges of a slice on its z face*/
+    for (unsigned int y = box.yBegin; y <= box.yEnd; ++y)
+    {
+        const bool onY = (y == box.yBegin && hasLowerY) || (y == box.yEnd && hasUpperY);
+        for (unsigned int x = box.xBegin; x <= box.xEnd; ++x)
+        {
+            const bool onX = (x == box.xBegin && hasLowerX) || (x == box.xEnd && hasUpperX);
+            if (!onX && !onY && !hasLowerZ && !hasUpperZ)
+            {
+                continue;
+            }
+
+            const size_t point = static_cast<size_t>(y - edgeCache.originY) * edgeCache.stride + x - edgeCache.originX;
+            const unsigned int *lowerEdges = edgeCache.planes[edgeCache.lowerPlane].data() + point * 2;
+            const unsigned int *upperEdges = edgeCache.planes[1 - edgeCache.lowerPlane].data() + point * 2;
+
+            if (onY || hasLowerZ)
+            {
+                collect(lowerEdges[0], sliceStart, x, y, z, 0);
+            }
+            if (onX || hasLowerZ)
+            {
+                collect(lowerEdges[1], sliceStart, x, y, z, 1);
+            }
+            if (onX || onY)
+            {
+                collect(edgeCache.depthEdges[point], edgeCache.upperStart, x, y, z, 2);
+            }
+
+            /** Slice z + 1 is the lower slice of the next layer, it is only collected here after the last layer*/
+            if (z + 1 == box.zEnd)
+            {
+                if (onY || hasUpperZ)
+                {
+                    collect(upperEdges[0], edgeCache.upperStart, x, y, z + 1, 0);
+                }
+                if (onX || hasUpperZ)
+                {
+                    collect(upperEdges[1], edgeCache.upperStart, x, y, z + 1, 1);
+                }
+            }
+        }
+    }
 }
 
-void MarchingCube::CalculateMesh(const unsigned int x, const unsigned int y, const unsigned int z)
+void MarchingCube::AssembleMeshChunks() const
 {
+    currentMesh.vertices.clear();
+    currentMesh.indices.clear();
+    currentMesh.normals.clear();
+    currentMesh.firstVertex = 0;
+    currentMesh.boundingBox = EmptyBounding();
+
+    /** Gradient normals toggled between two patches leave some chunks without normals, the mesh only has normals if every chunk has them*/
+    size_t vertexCount = 0, indexCount = 0;
+    bool withNormals = true;
+    for (const auto &chunk : meshChunks)
+    {
+        vertexCount += chunk.vertices.size();
+        indexCount += chunk.indices.size();
+        withNormals = withNormals && chunk.normals.size() == chunk.vertices.size();
+    }
+    currentMesh.vertices.reserve(vertexCount);
+    currentMesh.indices.reserve(indexCount);
+    if (withNormals)
+    {
+        currentMesh.normals.reserve(vertexCount);
+    }
+
     /**
-     * Iterate over 8 points of a cube
-     * and compare with the isosurface,
-     * check whether a surface is outside or inside the points of a cube
-     *
-     * cubeVertices => The Value of each 8 vertices
+     * A cut edge on a face between two chunks has a vertex in both. The first chunk holding it keeps it,
+     * a later one finds it on one of its lower faces and takes the vertex of the neighbour across that face,
+     * so the mesh shares its vertices as a march does
      */
-    std::vector<unsigned int> cubeVerticesValue;
-    cubeVerticesValue.resize(8);
+    unsigned int chunksWidth, chunksHeight, chunksDepth;
+    GetChunkGridSize(chunksWidth, chunksHeight, chunksDepth);
+    const size_t chunkLayer = static_cast<size_t>(chunksWidth) * chunksHeight;
 
-    for (int i = 0; i < 8; ++i)
+    /** Index in the current mesh of every vertex of every chunk*/
+    std::vector<std::vector<unsigned int>> vertexMaps(meshChunks.size());
+    for (size_t c = 0; c < meshChunks.size(); ++c)
     {
-        cubeVerticesValue[i] = GetPointData(
-            /** The x offset from Raw file to cube width*/
-            x + Table::cubeVertices[i][0],
+        const auto &chunk = meshChunks[c];
+        if (chunk.vertices.empty())
+        {
+            continue;
+        }
 
-            /** The y offset from Raw file to cube height */
-            y + Table::cubeVertices[i][1],
+        auto &vertexMap = vertexMaps[c];
+        vertexMap.assign(chunk.vertices.size(), EMPTY_EDGE);
+
+        const size_t neighbours[3] = {
+            c % chunksWidth > 0 ? c - 1 : c,
+            c / chunksWidth % chunksHeight > 0 ? c - chunksWidth : c,
+            c >= chunkLayer ? c - chunkLayer : c};
+        for (const auto neighbour : neighbours)
+        {
+            if (neighbour == c)
+            {
+                continue;
+            }
+            const auto &lower = chunkEdges[neighbour];
+            auto lowerEdge = lower.begin();
+            for (const auto &edge : chunkEdges[c])
+            {
+                while (lowerEdge != lower.end() && lowerEdge->edge < edge.edge)
+                {
+                    ++lowerEdge;
+                }
+                if (lowerEdge != lower.end() && lowerEdge->edge == edge.edge)
+                {
+                    vertexMap[edge.vertex] = vertexMaps[neighbour][lowerEdge->vertex];
+                }
+            }
+        }
+
+        for (size_t v = 0; v < chunk.vertices.size(); ++v)
+        {
+            if (vertexMap[v] != EMPTY_EDGE)
+            {
+                continue;
+            }
+            vertexMap[v] = static_cast<unsigned int>(currentMesh.vertices.size());
+            currentMesh.vertices.emplace_back(chunk.vertices[v]);
+            if (withNormals)
+            {
+                currentMesh.normals.emplace_back(chunk.normals[v]);
+            }
+        }
+        for (const auto index : chunk.indices)
+        {
+            currentMesh.indices.emplace_back(vertexMap[index]);
+        }
 
-            /** The z offset from Raw file to cube depth */
-            z + Table::cubeVertices[i][2]);
+        CalculBounding(chunk.boundingBox[0], currentMesh.boundingBox);
+        CalculBounding(chunk.boundingBox[1], currentMesh.boundingBox);
     }
 
-    unsigned int cubeIndex = 0;
-    for (int i = 0; i < 8; ++i)
+    isChunkMeshAssembled = true;
+}
+
+void MarchingCube::ReleaseMeshChunks()
+{
+    meshChunks = std::vector<IndexedMesh>();
+    chunkEdges = std::vector<std::vector<ChunkEdge>>();
+    hasMeshChunks = false;
+    isChunkMeshAssembled = false;
+}
+
+void MarchingCube::UpdateBrickTree(const uPoint &first, const uPoint &last)
+{
+    if (rawDimension.width < 2 || rawDimension.height < 2 || rawDimension.depth < 2)
     {
-        /**
-         * If a point is inside the mesh, set the bit of this point to 1
-         * otherwise, set to 0
-         * same to
-         *  int cubeIndex = 0;
-            if (cubeValues[0] < isolevel) cubeIndex |= 1;
-            if (cubeValues[1] < isolevel) cubeIndex |= 2;
-            if (cubeValues[2] < isolevel) cubeIndex |= 4;
-            if (cubeValues[3] < isolevel) cubeIndex |= 8;
-            if (cubeValues[4] < isolevel) cubeIndex |= 16;
-            if (cubeValues[5] < isolevel) cubeIndex |= 32;
-            if (cubeValues[6] < isolevel) cubeIndex |= 64;
-            if (cubeValues[7] < isolevel) cubeIndex |= 128;
-         * */
-        if (cubeVerticesValue[i] < currentIsoSurface)
-        {
-            cubeIndex |= (1 << (i));
-        }
+        return;
     }
-    /** Find which edges of the cube that mesh cut*/
-    unsigned int edges = Table::edgeTable[cubeIndex];
 
-    /** store the corss point of the edge of a cube*/
-    std::vector<fPoint> edgeCrossVerteces(12);
+    auto &bricks = brickTree[0];
+    uPoint brickFirst, brickLast;
+    unsigned int unused;
+    PointBricks(first.x, bricks.width, brickFirst.x, unused);
+    PointBricks(first.y, bricks.height, brickFirst.y, unused);
+    PointBricks(first.z, bricks.depth, brickFirst.z, unused);
+    PointBricks(last.x, bricks.width, unused, brickLast.x);
+    PointBricks(last.y, bricks.height, unused, brickLast.y);
+    PointBricks(last.z, bricks.depth, unused, brickLast.z);
 
-    /** Iterate over this 12 bits*/
-    for (int i = 0; i < 12; i++)
+    /** min/max over the (BRICK_SIZE + 1)^3 points of every brick the patch touches*/
+    for (unsigned int bz = brickFirst.z; bz <= brickLast.z; ++bz)
     {
-        /** Bitwise "AND" these 12 bits*/
-        if (edges & (1 << i))
+        for (unsigned int by = brickFirst.y; by <= brickLast.y; ++by)
         {
-            /** Calculate p1 (from raw data point to cube point)*/
-            uPoint p1{
-                Table::cubeVertices[Table::cubeEdges[i][0]][0] + x,
-                Table::cubeVertices[Table::cubeEdges[i][0]][1] + y,
-                Table::cubeVertices[Table::cubeEdges[i][0]][2] + z,
-            };
-
-            uPoint p2{
-                Table::cubeVertices[Table::cubeEdges[i][1]][0] + x,
-                Table::cubeVertices[Table::cubeEdges[i][1]][1] + y,
-                Table::cubeVertices[Table::cubeEdges[i][1]][2] + z,
-            };
-
-            fPoint interpResult;
-            /** Interpolate
-             * p1 = vertex 1 from raw data to cube index 1
-             * p2 = vertex 2 from raw data to cube index 2
-             * p1Val = value of p1
-             * p2Val = value of p2
-             */
-            VertexInterpolate(
-                p1,
-                p2,
-                cubeVerticesValue[Table::cubeEdges[i][0]],
-                cubeVerticesValue[Table::cubeEdges[i][1]],
-                interpResult);
-            CalculBounding(interpResult);
-            edgeCrossVerteces[i] = std::move(interpResult);
+            for (unsigned int bx = brickFirst.x; bx <= brickLast.x; ++bx)
+            {
+                float brickMin = std::numeric_limits<float>::infinity(), brickMax = -brickMin;
+                const unsigned int xEnd = std::min((bx + 1) * BRICK_SIZE, rawDimension.width - 1);
+                const unsigned int yEnd = std::min((by + 1) * BRICK_SIZE, rawDimension.height - 1);
+                const unsigned int zEnd = std::min((bz + 1) * BRICK_SIZE, rawDimension.depth - 1);
+                for (unsigned int z = bz * BRICK_SIZE; z <= zEnd; ++z)
+                {
+                    for (unsigned int y = by * BRICK_SIZE; y <= yEnd; ++y)
+                    {
+                        float rowMin, rowMax;
+                        VisitVoxelType(
+                            rawDimension.voxelType,
+                            [&](auto point)
+                            {
+                                const auto *row = GetRowPoints<decltype(point)>(y, z);
+                                PointRange(row + bx * BRICK_SIZE, row + xEnd + 1, rowMin, rowMax);
+                            });
+                        brickMin = std::min(brickMin, rowMin);
+                        brickMax = std::max(brickMax, rowMax);
+                    }
+                }
+
+                const size_t index = (static_cast<size_t>(bz) * bricks.height + by) * bricks.width + bx;
+                bricks.min[index] = brickMin;
+                bricks.max[index] = brickMax;
+            }
         }
     }
-    /**
-     * find connected triangle from given connectaion table
-     * iterate til the value is equal to -1
-     * The point is in times of 3 and will stop when it reaches -1.
-     * The number of this edge will be stored in the triTable.
-     * So
-     *  i   => v0 of the triangle
-     *  i+1 => v1 of the triangle
-     *  i+2 => v2 of the triangle
-     *
-     * The array of triangles repersenting Mesh
-     * */
-    for (int i = 0; Table::triTable[cubeIndex][i] != -1; i += 3)
+
+    /** Merge the 2x2x2 children again up to the root*/
+    for (size_t level = 1; level < brickTree.size(); ++level)
     {
-        Triangle tri{
-            /** Triangle v0 vertex*/
-            fPoint{
-                edgeCrossVerteces[Table::triTable[cubeIndex][i]].x,
-                edgeCrossVerteces[Table::triTable[cubeIndex][i]].y,
-                edgeCrossVerteces[Table::triTable[cubeIndex][i]].z},
-            /** Triangle v1 vertex*/
-            fPoint{
-                edgeCrossVerteces[Table::triTable[cubeIndex][i + 1]].x,
-                edgeCrossVerteces[Table::triTable[cubeIndex][i + 1]].y,
-                edgeCrossVerteces[Table::triTable[cubeIndex][i + 1]].z},
-            /** Triangle v2 vertex*/
-            fPoint{
-                edgeCrossVerteces[Table::triTable[cubeIndex][i + 2]].x,
-                edgeCrossVerteces[Table::triTable[cubeIndex][i + 2]].y,
-                edgeCrossVerteces[Table::triTable[cubeIndex][i + 2]].z}};
+        const auto &child = brickTree[level - 1];
+        auto &parent = brickTree[level];
+        brickFirst = uPoint{brickFirst.x / 2, brickFirst.y / 2, brickFirst.z / 2};
+        brickLast = uPoint{brickLast.x / 2, brickLast.y / 2, brickLast.z / 2};
+
+        for (unsigned int z = brickFirst.z; z <= brickLast.z; ++z)
+        {
+            for (unsigned int y = brickFirst.y; y <= brickLast.y; ++y)
+            {
+                for (unsigned int x = brickFirst.x; x <= brickLast.x; ++x)
+                {
+                    float nodeMin = std::numeric_limits<float>::infinity(), nodeMax = -nodeMin;
+                    for (unsigned int cz = z * 2; cz < std::min(z * 2 + 2, child.depth); ++cz)
+                    {
+                        for (unsigned int cy = y * 2; cy < std::min(y * 2 + 2, child.height); ++cy)
+                        {
+                            for (unsigned int cx = x * 2; cx < std::min(x * 2 + 2, child.width); ++cx)
+                            {
+                                const size_t childIndex = (static_cast<size_t>(cz) * child.height + cy) * child.width + cx;
+                                nodeMin = std::min(nodeMin, child.min[childIndex]);
+                                nodeMax = std::max(nodeMax, child.max[childIndex]);
+                            }
+                        }
+                    }
 
-        currentMesh.emplace_back(std::move(tri));
+                    const size_t index = (static_cast<size_t>(z) * parent.height + y) * parent.width + x;
+                    parent.min[index] = nodeMin;
+                    parent.max[index] = nodeMax;
+                }
+            }
+        }
     }
 }
 
-void MarchingCube::GetCurrentMesh(std::vector<Triangle> &outMesh) const
+void MarchingCube::SetBrickSkipping(const bool isSkipping)
 {
-    outMesh = std::vector<Triangle>(currentMesh.begin(), currentMesh.end());
+    isBrickSkipping = isSkipping;
 }
 
-void MarchingCube::GetCurrentMeshNormalized(std::vector<Triangle> &outMesh) const
+void MarchingCube::SetGradientNormals(const bool isEnabled)
 {
-    outMesh.resize(currentMesh.size());
+    isGradientNormals = isEnabled;
+}
 
-    for (int i = 0; i < currentMesh.size(); i++)
+size_t MarchingCube::GetBrickTreeMemory() const
+{
+    size_t bytes = 0;
+    for (const auto &level : brickTree)
     {
-        outMesh[i] = {
-            fPoint{
-                2 * (currentMesh[i].v0.x - currentBoundingBox[1].x) / (currentBoundingBox[0].x - currentBoundingBox[1].x) - 1,
-                2 * (currentMesh[i].v0.y - currentBoundingBox[1].y) / (currentBoundingBox[0].y - currentBoundingBox[1].y) - 1,
-                2 * (currentMesh[i].v0.z - currentBoundingBox[1].z) / (currentBoundingBox[0].z - currentBoundingBox[1].z) - 1},
-            fPoint{
-                2 * (currentMesh[i].v1.x - currentBoundingBox[1].x) / (currentBoundingBox[0].x - currentBoundingBox[1].x) - 1,
-                2 * (currentMesh[i].v1.y - currentBoundingBox[1].y) / (currentBoundingBox[0].y - currentBoundingBox[1].y) - 1,
-                2 * (currentMesh[i].v1.z - currentBoundingBox[1].z) / (currentBoundingBox[0].z - currentBoundingBox[1].z) - 1
+        bytes += (level.min.size() + level.max.size()) * sizeof(float);
+    }
+    return bytes;
+}
 
-            },
-            fPoint{
-                2 * (currentMesh[i].v2.x - currentBoundingBox[1].x) / (currentBoundingBox[0].x - currentBoundingBox[1].x) - 1,
-                2 * (currentMesh[i].v2.y - currentBoundingBox[1].y) / (currentBoundingBox[0].y - currentBoundingBox[1].y) - 1,
-                2 * (currentMesh[i].v2.z - currentBoundingBox[1].z) / (currentBoundingBox[0].z - currentBoundingBox[1].z) - 1}};
+template <typename T>
+void MarchingCube::ThresholdRow(const T *row, const unsigned int width, const T threshold, uint64_t *outMask)
+{
+#if defined(MC_SIMD_AVX2)
+    if (isAVX2Supported)
+    {
+        ThresholdRowAVX2(row, width, threshold, outMask);
+        return;
     }
+#endif
+#if defined(MC_SIMD_X86)
+    ThresholdRowSSE2(row, width, threshold, outMask);
+#else
+    ThresholdRowScalar(row, 0, width, threshold, outMask);
+#endif
 }
 
-void MarchingCube::GetCurrentBoundingBox(fPoint &max, fPoint &min) const
+unsigned int MarchingCube::CountTrailingZeros(const uint64_t word)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return static_cast<unsigned int>(index);
+#else
+    return static_cast<unsigned int>(__builtin_ctzll(word));
+#endif
+}
+
+const uint8_t *MarchingCube::GetRowData(const unsigned int height, const unsigned int depth) const
 {
-    max = currentBoundingBox[0];
-    min = currentBoundingBox[1];
+    if (isStreaming)
+    {
+        return sliceWindow.data() + (static_cast<size_t>(depth % sliceWindowSlots) * rawDimension.height + height) * rawDimension.width * voxelBytes;
+    }
+
+    const auto index = (static_cast<size_t>(depth) * rawDimension.height + height) * rawDimension.width;
+    return rawData + index * voxelBytes;
 }
 
-unsigned int MarchingCube::GetPointData(const unsigned int width, const unsigned int height, const unsigned int depth) const
+template <typename T>
+const T *MarchingCube::GetRowPoints(const unsigned int height, const unsigned int depth) const
 {
-    const auto index = depth * rawDimension.height * rawDimension.width + height * rawDimension.width + width;
-    return static_cast<unsigned int>(rawBuffer[index]);
+    /** The buffers are allocated or mapped aligned and every row starts at a multiple of the point size*/
+    return reinterpret_cast<const T *>(GetRowData(height, depth));
 }
 
-void MarchingCube::VertexInterpolate(const uPoint &p1, const uPoint &p2, const unsigned int p1Val, const unsigned int p2Val, fPoint &outInterp) const
+float MarchingCube::VertexInterpolate(const uPoint &p1, const uPoint &p2, const float p1Val, const float p2Val, const float isoSurface, fPoint &outInterp) const
 {
 
     /**
@@ -247,77 +2616,203 @@ void MarchingCube::VertexInterpolate(const uPoint &p1, const uPoint &p2, const u
     }
     else
     {
-        ratio = (static_cast<float>(currentIsoSurface) - static_cast<float>(p1Val)) / (static_cast<float>(p2Val) - static_cast<float>(p1Val));
+        ratio = (isoSurface - p1Val) / (p2Val - p1Val);
     }
 
     outInterp = fPoint{
         static_cast<float>(p1.x) + ratio * (static_cast<float>(p2.x) - static_cast<float>(p1.x)),
         static_cast<float>(p1.y) + ratio * (static_cast<float>(p2.y) - static_cast<float>(p1.y)),
         static_cast<float>(p1.z) + ratio * (static_cast<float>(p2.z) - static_cast<float>(p1.z))};
+    return ratio;
 }
 
-void MarchingCube::WriteCurrentMeshToObj(const std::string &objFilename)
+template <typename T>
+void MarchingCube::PointGradient(const uPoint &p, float outGradient[3]) const
 {
-    const std::string commentsString =
-        "# OBJ file generated by MarchingCube Algorithm\n"
-        "# Face Count = " +
-        std::to_string(currentMesh.size()) + "\n";
+    /** (v(p + 1) - v(p - 1)) / 2 along every axis, a point on a face of the volume only has one neighbour along its normal*/
+    const unsigned int xLow = p.x > 0 ? p.x - 1 : 0, xHigh = std::min(p.x + 1, rawDimension.width - 1);
+    const unsigned int yLow = p.y > 0 ? p.y - 1 : 0, yHigh = std::min(p.y + 1, rawDimension.height - 1);
+    const unsigned int zLow = p.z > 0 ? p.z - 1 : 0, zHigh = std::min(p.z + 1, rawDimension.depth - 1);
+
+    const T *row = GetRowPoints<T>(p.y, p.z);
+    outGradient[0] = (static_cast<float>(row[xHigh]) - static_cast<float>(row[xLow])) / static_cast<float>(xHigh - xLow);
+    outGradient[1] = (static_cast<float>(GetRowPoints<T>(yHigh, p.z)[p.x]) - static_cast<float>(GetRowPoints<T>(yLow, p.z)[p.x])) / static_cast<float>(yHigh - yLow);
+    outGradient[2] = (static_cast<float>(GetRowPoints<T>(p.y, zHigh)[p.x]) - static_cast<float>(GetRowPoints<T>(p.y, zLow)[p.x])) / static_cast<float>(zHigh - zLow);
+}
 
-    std::ofstream outFile(std::filesystem::absolute(objFilename).string());
+bool MarchingCube::WriteCurrentMeshToObj(const std::string &objFilename)
+{
+    return WriteCurrentMeshToObj(objFilename, 1);
+}
 
-    outFile << commentsString;
+bool MarchingCube::WriteCurrentMeshToObj(const std::string &objFilename, const unsigned int threadCount)
+{
+    const auto &mesh = CurrentMesh();
+    return MeshWriter::WriteObj(objFilename, mesh.vertices, mesh.indices, threadCount);
+}
 
-    if (!currentMesh.empty())
+bool MarchingCube::WriteCurrentMeshToPly(const std::string &plyFilename, const bool withNormals)
+{
+    const auto &mesh = CurrentMesh();
+    if (withNormals && !mesh.normals.empty())
     {
-        for (int i = 0; i < currentMesh.size(); i++)
-        {
-            const std::string v0 = "v " + std::to_string(currentMesh[i].v0.x) + " " + std::to_string(currentMesh[i].v0.y) + " " + std::to_string(currentMesh[i].v0.z) + "\n";
-            const std::string v1 = "v " + std::to_string(currentMesh[i].v1.x) + " " + std::to_string(currentMesh[i].v1.y) + " " + std::to_string(currentMesh[i].v1.z) + "\n";
-            const std::string v2 = "v " + std::to_string(currentMesh[i].v2.x) + " " + std::to_string(currentMesh[i].v2.y) + " " + std::to_string(currentMesh[i].v2.z) + "\n";
-            const std::string f = "f " + std::to_string(i * 3 + 1) + " " + std::to_string(i * 3 + 2) + " " + std::to_string(i * 3 + 3) + "\n";
+        return MeshWriter::WritePly(plyFilename, mesh.vertices, mesh.normals, mesh.indices);
+    }
 
-            outFile << "v " + std::to_string(currentMesh[i].v0.x) + " " + std::to_string(currentMesh[i].v0.y) + " " + std::to_string(currentMesh[i].v0.z) + "\n"
-                    << "v " + std::to_string(currentMesh[i].v1.x) + " " + std::to_string(currentMesh[i].v1.y) + " " + std::to_string(currentMesh[i].v1.z) + "\n"
-                    << "v " + std::to_string(currentMesh[i].v2.x) + " " + std::to_string(currentMesh[i].v2.y) + " " + std::to_string(currentMesh[i].v2.z) + "\n";
-        }
+    std::vector<fPoint> normals;
+    if (withNormals)
+    {
+        CalculateVertexNormals(mesh.vertices, mesh.indices, normals);
+    }
+    return MeshWriter::WritePly(plyFilename, mesh.vertices, normals, mesh.indices);
+}
 
-        for (int i = 0; i < currentMesh.size(); i++)
+bool MarchingCube::WriteCurrentMeshToStl(const std::string &stlFilename)
+{
+    const auto &mesh = CurrentMesh();
+    return MeshWriter::WriteStl(stlFilename, mesh.vertices, mesh.indices);
+}
+
+bool MarchingCube::WriteCurrentMeshToQuantized(const std::string &filename, const bool isCompressed)
+{
+    const auto &mesh = CurrentMesh();
+    return QuantizedMesh::Write(filename, mesh.vertices, mesh.indices, mesh.boundingBox[0], mesh.boundingBox[1], isCompressed);
+}
+
+void MarchingCube::CalculateVertexNormals(const std::vector<fPoint> &vertices, const std::vector<unsigned int> &indices, std::vector<fPoint> &outNormals)
+{
+    outNormals.assign(vertices.size(), fPoint{0, 0, 0});
+
+    /** The cross product is twice the area of the face, left unnormalized it weights the face by its area*/
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        const fPoint &v0 = vertices[indices[i]];
+        const fPoint &v1 = vertices[indices[i + 1]];
+        const fPoint &v2 = vertices[indices[i + 2]];
+
+        const fPoint outerProduct = MeshNormal::FaceCross(v0, v1, v2);
+
+        for (unsigned int j = 0; j < 3; ++j)
         {
-            outFile << "f " + std::to_string(i * 3 + 1) + " " + std::to_string(i * 3 + 2) + " " + std::to_string(i * 3 + 3) + "\n";
+            auto &normal = outNormals[indices[i + j]];
+            normal.x += outerProduct.x;
+            normal.y += outerProduct.y;
+            normal.z += outerProduct.z;
         }
     }
 
-    outFile.close();
+    for (auto &normal : outNormals)
+    {
+        normal = MeshNormal::Unit(normal);
+    }
 }
 
-void MarchingCube::CalculBounding(const fPoint &fCoordinates)
+void MarchingCube::CalculBounding(const fPoint &fCoordinates, std::vector<fPoint> &boundingBox)
 {
     /** Calculate bounding box*/
-    if (fCoordinates.x > currentBoundingBox[0].x)
+    if (fCoordinates.x > boundingBox[0].x)
+    {
+        boundingBox[0].x = fCoordinates.x;
+    }
+    if (fCoordinates.y > boundingBox[0].y)
+    {
+        boundingBox[0].y = fCoordinates.y;
+    }
+    if (fCoordinates.z > boundingBox[0].z)
+    {
+        boundingBox[0].z = fCoordinates.z;
+    }
+
+    if (fCoordinates.x < boundingBox[1].x)
     {
-        currentBoundingBox[0].x = fCoordinates.x;
+        boundingBox[1].x = fCoordinates.x;
     }
-    if (fCoordinates.y > currentBoundingBox[0].y)
+    if (fCoordinates.y < boundingBox[1].y)
     {
-        currentBoundingBox[0].y = fCoordinates.y;
+        boundingBox[1].y = fCoordinates.y;
     }
-    if (fCoordinates.z > currentBoundingBox[0].z)
+    if (fCoordinates.z < boundingBox[1].z)
     {
-        currentBoundingBox[0].z = fCoordinates.z;
+        boundingBox[1].z = fCoordinates.z;
     }
+}
 
-    if (fCoordinates.x < currentBoundingBox[1].x)
+void MarchingCube::ReduceBounding(const fPoint *vertices, const size_t count, std::vector<fPoint> &boundingBox)
+{
+    if (count == 0)
     {
-        currentBoundingBox[1].x = fCoordinates.x;
+        return;
     }
-    if (fCoordinates.y < currentBoundingBox[1].y)
+
+    const float *stream = reinterpret_cast<const float *>(vertices);
+    float highest[3] = {boundingBox[0].x, boundingBox[0].y, boundingBox[0].z};
+    float lowest[3] = {boundingBox[1].x, boundingBox[1].y, boundingBox[1].z};
+
+    size_t v = 0;
+#if defined(MC_SIMD_X86)
+    /**
+     * 4 vertices are 3 registers of xyzx yzxy zxyz,
+     * every lane keeps one axis so the registers reduce on their own and the lanes are folded per axis at the end
+     */
+    if (count >= 4)
     {
-        currentBoundingBox[1].y = fCoordinates.y;
+        __m128 max0 = _mm_loadu_ps(stream), max1 = _mm_loadu_ps(stream + 4), max2 = _mm_loadu_ps(stream + 8);
+        __m128 min0 = max0, min1 = max1, min2 = max2;
+        for (v = 4; v + 4 <= count; v += 4)
+        {
+            const float *src = stream + v * 3;
+            const __m128 a = _mm_loadu_ps(src), b = _mm_loadu_ps(src + 4), c = _mm_loadu_ps(src + 8);
+            max0 = _mm_max_ps(max0, a);
+            max1 = _mm_max_ps(max1, b);
+            max2 = _mm_max_ps(max2, c);
+            min0 = _mm_min_ps(min0, a);
+            min1 = _mm_min_ps(min1, b);
+            min2 = _mm_min_ps(min2, c);
+        }
+
+        float lanes[12];
+        _mm_storeu_ps(lanes, max0);
+        _mm_storeu_ps(lanes + 4, max1);
+        _mm_storeu_ps(lanes + 8, max2);
+        for (int i = 0; i < 12; ++i)
+        {
+            highest[i % 3] = std::max(highest[i % 3], lanes[i]);
+        }
+        _mm_storeu_ps(lanes, min0);
+        _mm_storeu_ps(lanes + 4, min1);
+        _mm_storeu_ps(lanes + 8, min2);
+        for (int i = 0; i < 12; ++i)
+        {
+            lowest[i % 3] = std::min(lowest[i % 3], lanes[i]);
+        }
     }
-    if (fCoordinates.z < currentBoundingBox[1].z)
+#endif
+
+    for (; v < count; ++v)
     {
-        currentBoundingBox[1].z = fCoordinates.z;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            highest[axis] = std::max(highest[axis], stream[v * 3 + axis]);
+            lowest[axis] = std::min(lowest[axis], stream[v * 3 + axis]);
+        }
     }
+
+    boundingBox[0] = fPoint{highest[0], highest[1], highest[2]};
+    boundingBox[1] = fPoint{lowest[0], lowest[1], lowest[2]};
+}
+
+std::vector<fPoint> MarchingCube::EmptyBounding()
+{
+    /** min() is the smallest positive float, the max has to start from the lowest one*/
+    return {
+        fPoint{
+            std::numeric_limits<float>::lowest(),
+            std::numeric_limits<float>::lowest(),
+            std::numeric_limits<float>::lowest()},
+        fPoint{
+            std::numeric_limits<float>::max(),
+            std::numeric_limits<float>::max(),
+            std::numeric_limits<float>::max()}};
 }
 
 bool MarchingCube::ParseFileName(const std::string &filename, Dimension &dimension)
@@ -335,9 +2830,26 @@ bool MarchingCube::ParseFileName(const std::string &filename, Dimension &dimensi
     std::string rawString;
     std::regex numberPattern("[0-9]+");
 
+    /** An optional voxel type after the depth, e.g. head_512_512_300_s16.raw, 8 bit without it*/
+    const std::pair<std::string, unsigned int> voxelTypeNames[] = {
+        {"u8", VOXEL_UINT8}, {"u16", VOXEL_UINT16}, {"s16", VOXEL_INT16}, {"f32", VOXEL_FLOAT32}};
+    unsigned int voxelType = VOXEL_UINT8;
+
     while (std::getline(ss, rawString, '_'))
     {
-        if (!std::regex_search(rawString, numberPattern))
+        if (vec.size() >= 3)
+        {
+            const auto typeName = rawString.substr(0, rawString.find('.'));
+            for (const auto &name : voxelTypeNames)
+            {
+                if (typeName == name.first)
+                {
+                    voxelType = name.second;
+                }
+            }
+        }
+
+        if (!std::regex_search(rawString, numberPattern) || !isdigit(static_cast<unsigned char>(rawString[0])))
         {
             continue;
         }
@@ -353,36 +2865,72 @@ bool MarchingCube::ParseFileName(const std::string &filename, Dimension &dimensi
     dimension = Dimension{
         static_cast<unsigned int>(vec[0]),
         static_cast<unsigned int>(vec[1]),
-        static_cast<unsigned int>(vec[2])};
+        static_cast<unsigned int>(vec[2]),
+        voxelType};
     return true;
 }
 
 void MarchingCube::GetMeshNormal(const std::vector<Triangle> &inputTri, std::vector<fPoint> &outTriNormal)
 {
-    for (const auto &m : inputTri)
+    /** The normals are appended behind the ones already there*/
+    const size_t first = outTriNormal.size();
+    outTriNormal.resize(first + inputTri.size());
+    CalculateFaceNormals(inputTri.data(), inputTri.size(), outTriNormal.data() + first, 1);
+}
+
+size_t MarchingCube::CalculateFaceNormals(const Triangle *faces, const size_t faceCount, fPoint *outNormals, const unsigned int inputThreadCount)
+{
+    /** 0 means one thread per hardware core, a thread gets FACE_NORMAL_CHUNK_FACES at least*/
+    unsigned int threadCount = inputThreadCount;
+    if (threadCount == 0)
     {
-        fPoint vector0{
-            m.v1.x - m.v0.x,
-            m.v1.y - m.v0.y,
-            m.v1.z - m.v0.z,
-        };
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threadCount = static_cast<unsigned int>(std::max<size_t>(1, std::min<size_t>(threadCount, faceCount / FACE_NORMAL_CHUNK_FACES)));
 
-        fPoint vector1{
-            m.v2.x - m.v0.x,
-            m.v2.y - m.v0.y,
-            m.v2.z - m.v0.z,
-        };
+    if (threadCount == 1)
+    {
+        return FaceNormalsRange(faces, outNormals, 0, faceCount);
+    }
 
-        fPoint outerProduct{
-            vector0.y * vector1.z - vector0.z * vector1.y,
-            vector0.z * vector1.x - vector0.x * vector1.z,
-            vector0.x * vector1.y - vector0.y * vector1.x};
+    const size_t chunkCount = (faceCount + FACE_NORMAL_CHUNK_FACES - 1) / FACE_NORMAL_CHUNK_FACES;
+    std::atomic<size_t> nextChunk{0};
+    std::atomic<size_t> degenerate{0};
+    auto worker = [&]()
+    {
+        size_t chunkDegenerate = 0;
+        for (size_t chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++)
+        {
+            const size_t begin = chunk * FACE_NORMAL_CHUNK_FACES;
+            chunkDegenerate += FaceNormalsRange(faces, outNormals, begin, std::min(faceCount, begin + FACE_NORMAL_CHUNK_FACES));
+        }
+        degenerate += chunkDegenerate;
+    };
 
-        float distance = std::sqrt(outerProduct.x * outerProduct.x + outerProduct.y * outerProduct.y + outerProduct.z * outerProduct.z);
+    std::vector<std::thread> workers;
+    for (unsigned int i = 1; i < threadCount; ++i)
+    {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto &w : workers)
+    {
+        w.join();
+    }
+    return degenerate;
+}
 
-        outTriNormal.emplace_back<fPoint>(fPoint{
-            outerProduct.x / distance,
-            outerProduct.y / distance,
-            outerProduct.z / distance});
+size_t MarchingCube::FaceNormalsRange(const Triangle *faces, fPoint *outNormals, const size_t begin, const size_t end)
+{
+#if defined(MC_SIMD_AVX2)
+    if (isAVX2Supported)
+    {
+        return FaceNormalsAVX2(faces, outNormals, begin, end);
     }
+#endif
+#if defined(MC_SIMD_X86)
+    return FaceNormalsSSE2(faces, outNormals, begin, end);
+#else
+    return FaceNormalsScalar(faces, outNormals, begin, end);
+#endif
 }
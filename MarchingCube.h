@@ -1,54 +1,527 @@
 #ifndef __MARCHING_CUBE_H__
 #define __MARCHING_CUBE_H__
 #include "Types.h"
+#include "MappedFile.h"
 
 #include <vector>
 #include <string>
+#include <functional>
+#include <stdint.h>
+
+/** Receives the triangles of a march batch by batch, in the same order as GetCurrentMesh*/
+class MeshSink
+{
+public:
+    virtual ~MeshSink() {}
+
+    /** The batch is only valid during the call*/
+    virtual void Consume(const Triangle *, const size_t) = 0;
+};
 
 class MarchingCube
 {
 public:
+    /**
+     * The points are of the voxel type of the dimension (VOXEL_* of Types.h), a buffer holds them as bytes.
+     * An unknown voxel type or a buffer shorter than the dimension loads nothing
+     */
     MarchingCube(const std::string &, const Dimension &);
     MarchingCube(const std::vector<uint8_t> &, const Dimension &);
 
+    /**
+     * Streaming instance => the raw file is never loaded as a whole,
+     * March reads it two slices at a time so the memory grows with width * height only.
+     * Marching is always serial and there is no brick tree nor span space index,
+     * the mesh is the same as the serial March of a loaded instance
+     */
+    MarchingCube(const std::string &, const Dimension &, const bool);
+
     ~MarchingCube();
 
+    /** false if the raw file cannot be opened or is smaller than the dimension*/
+    bool IsLoaded() const;
+    bool IsStreaming() const;
+    unsigned int GetVoxelType() const;
+
     void March(const unsigned int);
+    void March(const unsigned int, const unsigned int);
     void March();
 
+    /**
+     * Isovalue in the unit of the points (e.g. -500 Hounsfield units of an int16 volume), thread count as March.
+     * The unsigned isovalues of the other marches are the same as these with the value converted.
+     * A point is inside if it is below the isovalue, a NaN point of a float volume never is
+     */
+    void MarchValue(const float, const unsigned int);
+    bool MarchValue(const float, MeshSink &);
+    void MarchMultiValues(const std::vector<float> &, const unsigned int);
+    void MarchChunkedValue(const float, const unsigned int);
+
+    /**
+     * March on the calling thread and push the triangles to the sink as the layers are done,
+     * only the vertices of the last layer are kept so the mesh is never held as a whole.
+     * The current mesh is left empty but for its bounding box,
+     * false if a streaming instance cannot read its raw file (the sink may have received a part of the mesh)
+     */
+    bool March(const unsigned int, MeshSink &);
+
+    /**
+     * March several isosurfaces in one pass over the volume, every layer is marched for each level
+     * while its two slices are still in the cache. Level i is the same mesh as March(isoSurfaces[i]),
+     * thread count as March (0 => one thread per hardware core). The current mesh is not touched
+     */
+    void MarchMulti(const std::vector<unsigned int> &);
+    void MarchMulti(const std::vector<unsigned int> &, const unsigned int);
+
+    /** Levels of the last MarchMulti, the getters are false if the level does not exist*/
+    unsigned int GetLevelCount() const;
+    bool GetLevelMesh(const unsigned int, std::vector<Triangle> &) const;
+    bool GetLevelIndexedMesh(const unsigned int, std::vector<fPoint> &, std::vector<unsigned int> &) const;
+    bool GetLevelBoundingBox(const unsigned int, fPoint &, fPoint &) const;
+
+    /** Copy a level into the current mesh, so the current mesh getters and writers work on it*/
+    bool SelectLevel(const unsigned int);
+
+    /**
+     * Overwrite the points of a box of the volume => first point of the box, box size, points of the box (x fastest).
+     * The brick tree and the span space index follow the new points, and the current mesh is updated
+     * by re-marching only the mesh chunks around the box. The first patch after a March splits the mesh into chunks once.
+     * A mapped raw file is copied into memory by the first patch, the file itself is never written.
+     * The points are of the voxel type of the volume. false if the box does not fit the volume or the instance is streaming
+     */
+    bool PatchVolume(const uPoint &, const Dimension &, const uint8_t *);
+
+    /**
+     * March into mesh chunks of 32^3 cubes instead of one mesh, every chunk has its own vertices, indices and bounding box
+     * so it can be culled, streamed or written on its own. The chunks are marched in parallel (0 => one thread per hardware core).
+     * The current mesh is only assembled from the chunks once it is asked for, the cross points on a chunk boundary are made by both chunks
+     * and welded back into one vertex when the chunks are assembled.
+     * Streaming instances have no chunks
+     */
+    void MarchChunked(const unsigned int, const unsigned int);
+
+    /** Chunks of the chunk grid, x fastest, 0 unless the current mesh is chunked (MarchChunked or PatchVolume)*/
+    unsigned int GetChunkCount() const;
+    bool IsChunkEmpty(const unsigned int) const;
+
+    /** The getters are false if the chunk does not exist => first cube and cube count of the chunk, its mesh, its bounding box*/
+    bool GetChunkRegion(const unsigned int, uPoint &, Dimension &) const;
+    bool GetChunkIndexedMesh(const unsigned int, std::vector<fPoint> &, std::vector<unsigned int> &) const;
+    bool GetChunkBoundingBox(const unsigned int, fPoint &, fPoint &) const;
+    /** Vertex count and index count of the chunk*/
+    bool GetChunkMeshSize(const unsigned int, size_t &, size_t &) const;
+
+    /**
+     * Make a unit normal for every vertex while marching, from the gradient of the volume by central differences
+     * at the two points of the edge, interpolated along the edge like the vertex. Disabled by default,
+     * a streaming instance then reads four slices at a time and a mesh sink never receives normals
+     */
+    void SetGradientNormals(const bool);
+
+    /** Skip the bricks whose min/max range cannot contain the isosurface, enabled by default*/
+    void SetBrickSkipping(const bool);
+    size_t GetBrickTreeMemory() const;
+
+    /** Build the span space index within the memory budget in bytes, false if even the coarsest index does not fit*/
+    bool BuildSpanSpaceIndex(const size_t);
+    void ReleaseSpanSpaceIndex();
+    size_t GetSpanSpaceIndexMemory() const;
+
     void GetCurrentMesh(std::vector<Triangle> &) const;
     void GetCurrentMeshNormalized(std::vector<Triangle> &) const;
+    void GetCurrentIndexedMesh(std::vector<fPoint> &, std::vector<unsigned int> &) const;
+    void GetCurrentIndexedMeshNormalized(std::vector<fPoint> &, std::vector<unsigned int> &) const;
+
+    /** Normalized getters with the thread count normalizing the vertices (0 => one thread per hardware core)*/
+    void GetCurrentMeshNormalized(std::vector<Triangle> &, const unsigned int) const;
+    void GetCurrentIndexedMeshNormalized(std::vector<fPoint> &, std::vector<unsigned int> &, const unsigned int) const;
+
+    /**
+     * Normalize the current mesh in place instead of copying it, thread count as above.
+     * The bounding box becomes the normalized one and the mesh is no longer updated by PatchVolume
+     */
+    void NormalizeCurrentMesh(const unsigned int);
     void GetCurrentBoundingBox(fPoint &, fPoint &) const;
-    void WriteCurrentMeshToObj(const std::string &);
 
+    /**
+     * Gradient normals of the current mesh, one per vertex of GetCurrentIndexedMesh,
+     * true => the normals of the normalized mesh. false if the mesh was marched without gradient normals
+     */
+    bool GetCurrentVertexNormals(std::vector<fPoint> &, const bool) const;
+    /** Gradient normals as above, 3 per triangle in the order of GetCurrentMesh*/
+    bool GetCurrentMeshVertexNormals(std::vector<fPoint> &, const bool) const;
+
+    /** false if the file cannot be written*/
+    bool WriteCurrentMeshToObj(const std::string &);
+    /** filename, thread count formatting the lines (0 => one thread per hardware core)*/
+    bool WriteCurrentMeshToObj(const std::string &, const unsigned int);
+    /** Binary little endian PLY, with or without per vertex normals (the gradient normals if the mesh has them)*/
+    bool WriteCurrentMeshToPly(const std::string &, const bool);
+    /** Binary STL*/
+    bool WriteCurrentMeshToStl(const std::string &);
+    /** Quantized mesh container (QuantizedMesh.h), true => pack the sections with the LZ block codec*/
+    bool WriteCurrentMeshToQuantized(const std::string &, const bool);
+
+    /** name_width_height_depth[_type].raw, type => u8, u16, s16 or f32 (8 bit without it)*/
     static bool ParseFileName(const std::string &, Dimension &);
+
+    /** Bytes of a point of a voxel type, 0 if the type is unknown*/
+    static unsigned int GetVoxelBytes(const unsigned int);
+
     static void GetMeshNormal(const std::vector<Triangle> &, std::vector<fPoint> &);
 
+    /**
+     * Unit normal of every face by its winding => faces, face count, out normals (face count of them),
+     * thread count (0 => one thread per hardware core). The normals are written straight into the output,
+     * a face without area gets (0, 0, 0) instead of NaN, returns the count of those faces
+     */
+    static size_t CalculateFaceNormals(const Triangle *, const size_t, fPoint *, const unsigned int);
+
 private:
-    /** rawBuffer => Raw file's buffer */
+    /** Indexed mesh => vertices shared by the triangles, 3 indices per triangle and the bounding box of the vertices*/
+    struct IndexedMesh
+    {
+        std::vector<fPoint> vertices;
+        std::vector<unsigned int> indices;
+
+        /** Unit normal of every vertex from the volume gradient, empty if gradient normals were disabled*/
+        std::vector<fPoint> normals;
+
+        /** Index of vertices[0], the vertices before it have been handed out and dropped*/
+        unsigned int firstVertex = 0;
+
+        /** 0->max, 1->min */
+        std::vector<fPoint> boundingBox;
+    };
+
+    /**
+     * Vertex index of the cross point of every edge around the current layer of cubes (slice z to slice z + 1)
+     * planes[lowerPlane] => x and y edges on slice z, two per point
+     * planes[1 - lowerPlane] => x and y edges on slice z + 1, two per point
+     * depthEdges => z edges between slice z and slice z + 1, one per point
+     *
+     * The planes swap roles from layer to layer instead of being cleared,
+     * a slot is only valid if it was written after lowerStart (slice z) or upperStart (slice z + 1, z edges)
+     *
+     * Only the points of the walked box are cached => point (x, y) is slot (y - originY) * stride + x - originX
+     */
+    struct EdgeCache
+    {
+        std::vector<unsigned int> planes[2];
+        std::vector<unsigned int> depthEdges;
+        unsigned int lowerPlane;
+
+        unsigned int originX;
+        unsigned int originY;
+        unsigned int stride;
+
+        /** First vertex index made by the previous layer*/
+        unsigned int lowerStart;
+
+        /** First vertex index made by the current layer*/
+        unsigned int upperStart;
+    };
+
+    /** A cut x or y edge of a slice => its edge cache slot and the index of its vertex*/
+    struct SliceEdge
+    {
+        unsigned int slot;
+        unsigned int vertex;
+    };
+
+    /** A cut edge on a face a mesh chunk shares with another => (point index of its origin) * 3 + axis and the index of its vertex*/
+    struct ChunkEdge
+    {
+        uint64_t edge;
+        unsigned int vertex;
+    };
+
+    /** Cubes [xBegin, xEnd) x [yBegin, yEnd) x [zBegin, zEnd) of the volume*/
+    struct CubeBox
+    {
+        unsigned int xBegin;
+        unsigned int xEnd;
+        unsigned int yBegin;
+        unsigned int yEnd;
+        unsigned int zBegin;
+        unsigned int zEnd;
+    };
+
+    /** A cube cut by the surface => x, y offset in its layer and its cube index*/
+    struct ActiveCube
+    {
+        unsigned int x;
+        unsigned int y;
+        unsigned int cubeIndex;
+    };
+
+    /**
+     * Inside masks of the rows of one slice, rowSlice[y] => the slice row y was thresholded for,
+     * rows are only thresholded when a layer needs them
+     */
+    struct SliceMask
+    {
+        std::vector<uint64_t> words;
+        std::vector<unsigned int> rowSlice;
+    };
+
+    /** Everything a serial walk over the layers of a slab carries from one layer to the next*/
+    struct LayerWalk
+    {
+        EdgeCache edgeCache;
+
+        /** Inside bit of every point of slice z and slice z + 1, they swap roles like the edge cache planes*/
+        SliceMask sliceMasks[2];
+
+        std::vector<ActiveCube> activeCubes;
+
+        /** Only the cubes of the box are marched, box.zBegin is the first layer of the walk*/
+        CubeBox box;
+
+        float isoSurface;
+
+        /** Make the gradient normals of the vertices*/
+        bool withNormals;
+
+        /** Active bricks of the isosurface, see PrepareBricks*/
+        const uint8_t *activeBricks;
+    };
+
+    /**
+     * One level of the min/max brick tree
+     * level 0 => one node per brick of BRICK_SIZE^3 cubes, min/max over its (BRICK_SIZE + 1)^3 points
+     * level n + 1 => one node per 2x2x2 nodes of level n
+     * The min/max are floats whatever the voxel type, every 8 and 16 bit value is exact
+     */
+    struct BrickLevel
+    {
+        unsigned int width;
+        unsigned int height;
+        unsigned int depth;
+        std::vector<float> min;
+        std::vector<float> max;
+    };
+
+    /**
+     * Span space index over the nodes of one level of the brick tree, a lattice on the min axis:
+     * nodes are bucketed by their min value and every bucket is sorted by max from high to low,
+     * so the nodes cut by isosurface v are the heads of the buckets min < v whose max >= v.
+     * Nodes whose points are all equal can never be cut and are left out.
+     * There are 256 buckets, one per value of an 8 bit volume, wider buckets split the range of other volumes
+     * so the last bucket below v may also hold nodes whose min is not below v.
+     */
+    struct SpanSpaceIndex
+    {
+        unsigned int level;
+
+        /** Bucket of value v => (v - bucketLow) * bucketScale clamped to [0, 255]*/
+        float bucketLow;
+        float bucketScale;
+
+        /** Bucket of min value m => nodes[bucketOffsets[m], bucketOffsets[m + 1])*/
+        std::vector<unsigned int> bucketOffsets;
+        std::vector<unsigned int> nodes;
+        std::vector<float> nodeMax;
+    };
+
+    /** rawBuffer => Raw buffer given by the caller, rawFile => Raw file mapped in memory*/
     std::vector<uint8_t> rawBuffer;
+    MappedFile rawFile;
 
-    /** Mesh => Mesh calculated by current isosurface */
-    std::vector<Triangle> currentMesh;
+    /** rawData => the points of the volume, from rawBuffer or rawFile, nullptr if nothing is loaded*/
+    const uint8_t *rawData = nullptr;
 
-    /** Current mesh bounding box => 0->max, 1->min */
-    std::vector<fPoint> currentBoundingBox;
+    /** Bytes of a point, by the voxel type of rawDimension*/
+    unsigned int voxelBytes = 1;
 
-    unsigned int currentIsoSurface;
+    /**
+     * Streaming => rawFilename is read by March, slice z lives in slot z % sliceWindowSlots of sliceWindow while its layers are marched,
+     * 2 slots or 4 with gradient normals so the slices around both slices of a layer are there
+     */
+    bool isStreaming = false;
+    std::string rawFilename;
+    std::vector<uint8_t> sliceWindow;
+    unsigned int sliceWindowSlots = 2;
+
+    /** Mesh => Mesh calculated by current isosurface, assembled on demand from the mesh chunks while there are chunks*/
+    mutable IndexedMesh currentMesh;
+
+    float currentIsoSurface = 0;
+
+    /**
+     * Mesh chunks => the current mesh split by blocks of MESH_CHUNK_BRICKS^3 bricks, x fastest,
+     * every chunk is marched on its own so a patch only re-marches the chunks it touches.
+     * The current mesh is the chunks one after the other while hasMeshChunks is true
+     */
+    std::vector<IndexedMesh> meshChunks;
+    bool hasMeshChunks = false;
+
+    /** The cut edges on the faces every mesh chunk shares with its neighbours, their vertices are welded when the chunks are assembled*/
+    std::vector<std::vector<ChunkEdge>> chunkEdges;
+    mutable bool isChunkMeshAssembled = false;
+
+    /** The current mesh was marched into memory (not handed to a sink), so a patch keeps it up to date*/
+    bool isCurrentMeshMarched = false;
+
+    /** Brick tree => built once with the instance, brickTree[0] are the bricks, brickTree.back() is the root*/
+    std::vector<BrickLevel> brickTree;
+
+    /** Active bricks of every level being marched, 1 => the brick may be cut*/
+    std::vector<std::vector<uint8_t>> levelActiveBricks;
+
+    /** Meshes of the last MarchMulti, one per isosurface*/
+    std::vector<float> levelIsoSurfaces;
+    std::vector<IndexedMesh> levelMeshes;
+
+    bool isBrickSkipping = true;
+    bool isGradientNormals = false;
+
+    /** Span space index => opt in, built by BuildSpanSpaceIndex*/
+    SpanSpaceIndex spanSpaceIndex;
+    bool hasSpanSpaceIndex = false;
+
+    /** Budget the span space index was built with, it is rebuilt with the same budget after a patch*/
+    size_t spanSpaceBudget = 0;
 
     Dimension rawDimension;
 
-    /** Calculate mesh by cube*/
-    void CalculateMesh(const unsigned int, const unsigned int, const unsigned int);
+    /** Map the raw file and build the brick tree, rawData stays nullptr if the file cannot be used*/
+    void LoadFile(const std::string &);
+
+    /** March every isosurface into its mesh, the meshes of the isosurfaces no cube can be cut by are left empty*/
+    void MarchLevels(const std::vector<float> &, const unsigned int, std::vector<IndexedMesh> &);
+
+    /** March the cubes whose z offset lies in [zBegin, zEnd), walk i into mesh i*/
+    void MarchSlab(const unsigned int, const unsigned int, std::vector<LayerWalk> &, const std::vector<IndexedMesh *> &) const;
+
+    /** plane of an edge cache, first valid vertex => the cut edges of the plane in slot order, the slots before it are stale*/
+    static void CollectSliceEdges(const std::vector<unsigned int> &, const unsigned int, std::vector<SliceEdge> &);
+
+    /** false if no cube can be cut by the isosurface, no point is below the lowest value of the voxel type nor above the highest one*/
+    bool IsCuttable(const float) const;
+
+    /** Flag the bricks the isosurface may cut, every brick if skipping is disabled*/
+    void PrepareBricks(const float, std::vector<uint8_t> &) const;
+
+    /**
+     * March every layer in order on the calling thread, walk i into mesh i,
+     * a streaming instance reads each slice just before it is needed.
+     * afterLayer (may be empty) is called once a walk has marched a layer, false if the raw file cannot be read
+     */
+    bool WalkLayers(std::vector<LayerWalk> &, const std::vector<IndexedMesh *> &, const std::function<void(IndexedMesh &, const LayerWalk &)> &);
+
+    /** The cubes of the layers [zBegin, zEnd) of the whole volume*/
+    CubeBox GetVolumeBox(const unsigned int, const unsigned int) const;
+
+    /** Prepare a walk over the cubes of the box for the isosurface and its active bricks*/
+    void BeginLayerWalk(const CubeBox &, const float, const uint8_t *, LayerWalk &) const;
+
+    /** Chunks of the chunk grid along x, y and z*/
+    void GetChunkGridSize(unsigned int &, unsigned int &, unsigned int &) const;
+
+    /** Cubes of a chunk, given its offset in the chunk grid*/
+    CubeBox GetChunkBox(const unsigned int, const unsigned int, const unsigned int) const;
+
+    /** March the chunks of the chunk grid box [first, last] of the current isosurface into the mesh chunks, thread count as March*/
+    void MarchChunks(const uPoint &, const uPoint &, const unsigned int);
+
+    /** z, walk over the cubes of a chunk, first valid vertex of slice z => the cut edges of the layer on the faces of the chunk with a neighbour*/
+    void CollectChunkEdges(const unsigned int, const LayerWalk &, const unsigned int, std::vector<ChunkEdge> &) const;
+
+    /** The current mesh, assembled from the mesh chunks first if they changed since*/
+    const IndexedMesh &CurrentMesh() const;
+
+    /** Rebuild the current mesh from the mesh chunks*/
+    void AssembleMeshChunks() const;
+    void ReleaseMeshChunks();
+
+    /** Refresh the min/max of the brick tree nodes containing the points [first, last] of the volume*/
+    void UpdateBrickTree(const uPoint &, const uPoint &);
+
+    /** March the cubes of layer z, the layers of a walk must be marched in order*/
+    void MarchLayer(const unsigned int, LayerWalk &, IndexedMesh &) const;
+
+    /** Make the triangles of the active cubes of layer z from their points of type T*/
+    template <typename T>
+    void MarchActiveCubes(const unsigned int, LayerWalk &, IndexedMesh &) const;
+
+    /** Number of 64 bit words of the inside mask of a row*/
+    unsigned int MaskWordsPerRow() const;
+
+    /** Make sure row y of the mask is thresholded for slice z over the words of the box, bit x of a row is set if point x is below the isosurface*/
+    void ThresholdMaskRow(SliceMask &, const unsigned int, const unsigned int, const CubeBox &, const float) const;
+
+    /** Combine the inside masks of slice z and z + 1 into the cube index of every cut cube of layer z in an active brick of the box*/
+    void ClassifyLayer(const unsigned int, const CubeBox &, const float, const uint8_t *, SliceMask &, SliceMask &, std::vector<ActiveCube> &) const;
+
+    /** Bricks of a brick layer along x and y*/
+    void GetBrickLayerSize(unsigned int &, unsigned int &) const;
+
+    /** Build the brick tree from the raw buffer*/
+    void BuildBrickTree();
+
+    /** Descend from a node of the brick tree and flag every brick under it that may be cut*/
+    void CollectActiveBricks(const unsigned int, const unsigned int, const unsigned int, const unsigned int, const float, std::vector<uint8_t> &) const;
+
+    /** Flag every brick that may be cut from the nodes the span space index reports*/
+    void CollectIndexedBricks(const float, std::vector<uint8_t> &) const;
+
+    /** Bucket of a value in the span space index*/
+    unsigned int SpanBucket(const float) const;
+
+    /** Build the inside mask of a row of points of type T with the widest SIMD the CPU supports*/
+    template <typename T>
+    static void ThresholdRow(const T *, const unsigned int, const T, uint64_t *);
+
+    static inline unsigned int CountTrailingZeros(const uint64_t);
+
+    /** Calculate mesh by cube, given its 8 vertex values and cube index, T => type of the points for the gradient normals*/
+    template <typename T>
+    void CalculateMesh(const unsigned int, const unsigned int, const unsigned int, const float[8], const unsigned int, const float, const bool, EdgeCache &, IndexedMesh &) const;
+
+    /** Gradient of the volume at a point by central differences, one sided on the faces of the volume*/
+    template <typename T>
+    inline void PointGradient(const uPoint &, float[3]) const;
+
+    /** Map the vertices into [-1, 1] by the current bounding box, in place if the output is the input, thread count (0 => one thread per hardware core)*/
+    void NormalizeVertices(const std::vector<fPoint> &, std::vector<fPoint> &, const unsigned int) const;
+
+    /** Normalize the vertices [begin, end) of an xyz float stream with the widest SIMD the CPU supports*/
+    static void NormalizeRange(const float *, float *, const size_t, const size_t, const float[3], const float[3]);
+
+    /** Map the normals of the current mesh to the normalized mesh, in place if the output is the input*/
+    void NormalizeNormals(const std::vector<fPoint> &, std::vector<fPoint> &) const;
+
+    /** Face normals of the faces [begin, end) with the widest SIMD the CPU supports, returns the count of faces without area*/
+    static size_t FaceNormalsRange(const Triangle *, fPoint *, const size_t, const size_t);
+
+    /** Normal of every vertex, the sum of the normals of the faces around it weighted by their area*/
+    static void CalculateVertexNormals(const std::vector<fPoint> &, const std::vector<unsigned int> &, std::vector<fPoint> &);
+
+    /** Expand an indexed mesh into separated triangles*/
+    static void ExpandTriangles(const std::vector<fPoint> &, const std::vector<unsigned int> &, std::vector<Triangle> &);
 
     /** Get data of a given point*/
-    inline unsigned int GetPointData(const unsigned int, const unsigned int, const unsigned int) const;
+    inline float GetPointData(const unsigned int, const unsigned int, const unsigned int) const;
+
+    /** Get the first byte of a row (height, depth) of the raw buffer*/
+    inline const uint8_t *GetRowData(const unsigned int, const unsigned int) const;
+
+    /** The row as points of the voxel type T*/
+    template <typename T>
+    inline const T *GetRowPoints(const unsigned int, const unsigned int) const;
+
+    /** Interpolate the cross point over the surface, returns its ratio along the edge from the first point*/
+    float VertexInterpolate(const uPoint &, const uPoint &, const float, const float, const float, fPoint &) const;
+
+    /** Grow the bounding box by a point, merges the bounding boxes of partial meshes*/
+    static inline void CalculBounding(const fPoint &, std::vector<fPoint> &);
 
-    /** Interpolate the cross point over the surface*/
-    void VertexInterpolate(const uPoint &, const uPoint &, const unsigned int, const unsigned int, fPoint &) const;
+    /** Grow the bounding box by the vertices with a SIMD min/max reduction*/
+    static void ReduceBounding(const fPoint *, const size_t, std::vector<fPoint> &);
 
-    /** Calculate the bounding box */
-    inline void CalculBounding(const fPoint &);
+    /** Initial bounding box before any point is calculated*/
+    static std::vector<fPoint> EmptyBounding();
 };
 
 #endif
\ No newline at end of file
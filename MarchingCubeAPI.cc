@@ -1,14 +1,80 @@
 #include "MarchingCubeAPI.h"
+#include <algorithm>
 #include <filesystem>
+#include <iterator>
 #include <memory>
 #include <vector>
 #include <string.h>
 #include "MarchingCube.h"
+#include "QuantizedMesh.h"
 
 #include <unordered_map>
 
 std::unordered_map<MCHandle, std::unique_ptr<MarchingCube>> instanceMapping;
 
+/** Level of a MarchMulti => its instance and its offset among the isosurfaces*/
+struct MarchLevel
+{
+    MCHandle instance;
+    unsigned int level;
+};
+
+std::unordered_map<MCLevelHandle, std::unique_ptr<MarchLevel>> levelMapping;
+
+/** Chunk iterator => its instance and the chunk it visits next*/
+struct ChunkCursor
+{
+    MCHandle instance;
+    unsigned int next;
+};
+
+std::unordered_map<MCChunkIterator, std::unique_ptr<ChunkCursor>> chunkIteratorMapping;
+
+/** Invalidate every level handle of the instance*/
+static void ReleaseLevels(const MCHandle handle)
+{
+    for (auto it = levelMapping.begin(); it != levelMapping.end();)
+    {
+        it = it->second->instance == handle ? levelMapping.erase(it) : std::next(it);
+    }
+}
+
+/** The unsigned isovalues of the API have always been 8 bit, the instances of wider voxel types take them whole*/
+static unsigned int InstanceIsoSurface(const MCHandle handle, const unsigned int isoSurface)
+{
+    return instanceMapping[handle]->GetVoxelType() == VOXEL_UINT8 ? static_cast<uint8_t>(isoSurface) : isoSurface;
+}
+
+/** Hand out a level handle for every level of the last MarchMulti of the instance*/
+static void RegisterLevels(const MCHandle handle, const unsigned int levelCount, MCLevelHandle *levels)
+{
+    for (unsigned int i = 0; i < levelCount; ++i)
+    {
+        auto level = std::make_unique<MarchLevel>(MarchLevel{handle, i});
+        levels[i] = reinterpret_cast<MCLevelHandle>(level.get());
+        levelMapping.insert(std::pair<MCLevelHandle, std::unique_ptr<MarchLevel>>(
+            levels[i],
+            std::move(level)));
+    }
+}
+
+/** Forward the batches of a march to a C callback*/
+class CallbackMeshSink : public MeshSink
+{
+public:
+    CallbackMeshSink(MCMeshSink inputCallback, void *inputUserData)
+        : callback(inputCallback), userData(inputUserData) {}
+
+    void Consume(const Triangle *triangles, const size_t count) override
+    {
+        callback(triangles, static_cast<unsigned int>(count), userData);
+    }
+
+private:
+    MCMeshSink callback;
+    void *userData;
+};
+
 MCHandle CreateMarchingCubeInstance(const char *filename, const Dimension *dimension)
 {
     if (!std::filesystem::exists(filename))
@@ -17,6 +83,28 @@ MCHandle CreateMarchingCubeInstance(const char *filename, const Dimension *dimen
     }
 
     auto instance = std::make_unique<MarchingCube>(filename, *dimension);
+    if (!instance->IsLoaded())
+    {
+        return 0;
+    }
+
+    auto handle = reinterpret_cast<MCHandle>(instance.get());
+
+    instanceMapping.insert(std::pair<MCHandle, std::unique_ptr<MarchingCube>>(
+        handle,
+        std::move(instance)));
+
+    return handle;
+}
+
+MCHandle CreateMarchingCubeStreamInstance(const char *filename, const Dimension *dimension)
+{
+    auto instance = std::make_unique<MarchingCube>(filename, *dimension, true);
+    if (!instance->IsLoaded())
+    {
+        return 0;
+    }
+
     auto handle = reinterpret_cast<MCHandle>(instance.get());
 
     instanceMapping.insert(std::pair<MCHandle, std::unique_ptr<MarchingCube>>(
@@ -28,8 +116,15 @@ MCHandle CreateMarchingCubeInstance(const char *filename, const Dimension *dimen
 
 MCHandle CreateMarchingCubeInstanceFromBuffer(const char *inputBuf, const int bufSize, const Dimension *dimension)
 {
-    std::vector<uint8_t> buf(dimension->width * dimension->height * dimension->depth);
-    memcpy(buf.data(), inputBuf, bufSize);
+    /** The buffer holds the points as bytes of the voxel type, a shorter buffer leaves the last points 0*/
+    const unsigned int voxelBytes = MarchingCube::GetVoxelBytes(dimension->voxelType);
+    if (voxelBytes == 0)
+    {
+        return 0;
+    }
+
+    std::vector<uint8_t> buf(static_cast<size_t>(dimension->width) * dimension->height * dimension->depth * voxelBytes);
+    memcpy(buf.data(), inputBuf, std::min(buf.size(), static_cast<size_t>(std::max(bufSize, 0))));
 
     auto instance = std::make_unique<MarchingCube>(buf, *dimension);
     auto handle = reinterpret_cast<MCHandle>(instance.get());
@@ -48,12 +143,32 @@ int CheckIsMCInstanceExists(const MCHandle handle)
 
 void ReleaseMarchingCubeInstance(const MCHandle handle)
 {
+    ReleaseLevels(handle);
+    for (auto it = chunkIteratorMapping.begin(); it != chunkIteratorMapping.end();)
+    {
+        it = it->second->instance == handle ? chunkIteratorMapping.erase(it) : std::next(it);
+    }
     instanceMapping.erase(handle);
 }
 
 void March(const MCHandle handle, const unsigned int isoSurface)
 {
-    instanceMapping[handle]->March(static_cast<uint8_t>(isoSurface));
+    instanceMapping[handle]->March(InstanceIsoSurface(handle, isoSurface));
+}
+
+void ParallelMarch(const MCHandle handle, const unsigned int isoSurface, const unsigned int threadCount)
+{
+    instanceMapping[handle]->March(InstanceIsoSurface(handle, isoSurface), threadCount);
+}
+
+void ParallelMarchValue(const MCHandle handle, const float isoSurface, const unsigned int threadCount)
+{
+    instanceMapping[handle]->MarchValue(isoSurface, threadCount);
+}
+
+unsigned int GetVoxelType(const MCHandle handle)
+{
+    return instanceMapping[handle]->GetVoxelType();
 }
 
 void DefaultMarch(const MCHandle handle)
@@ -61,6 +176,188 @@ void DefaultMarch(const MCHandle handle)
     instanceMapping[handle]->March();
 }
 
+int MarchToSink(const MCHandle handle, const unsigned int isoSurface, MCMeshSink sink, void *userData)
+{
+    CallbackMeshSink callbackSink(sink, userData);
+    return static_cast<int>(instanceMapping[handle]->March(InstanceIsoSurface(handle, isoSurface), callbackSink));
+}
+
+int MarchValueToSink(const MCHandle handle, const float isoSurface, MCMeshSink sink, void *userData)
+{
+    CallbackMeshSink callbackSink(sink, userData);
+    return static_cast<int>(instanceMapping[handle]->MarchValue(isoSurface, callbackSink));
+}
+
+void MarchMulti(const MCHandle handle, const unsigned int *isoSurfaces, const unsigned int levelCount, const unsigned int threadCount, MCLevelHandle *levels)
+{
+    std::vector<unsigned int> isoVec(levelCount);
+    for (unsigned int i = 0; i < levelCount; ++i)
+    {
+        isoVec[i] = InstanceIsoSurface(handle, isoSurfaces[i]);
+    }
+
+    ReleaseLevels(handle);
+    instanceMapping[handle]->MarchMulti(isoVec, threadCount);
+    RegisterLevels(handle, levelCount, levels);
+}
+
+void MarchMultiValues(const MCHandle handle, const float *isoSurfaces, const unsigned int levelCount, const unsigned int threadCount, MCLevelHandle *levels)
+{
+    ReleaseLevels(handle);
+    instanceMapping[handle]->MarchMultiValues(std::vector<float>(isoSurfaces, isoSurfaces + levelCount), threadCount);
+    RegisterLevels(handle, levelCount, levels);
+}
+
+int CheckIsLevelExists(const MCLevelHandle levelHandle)
+{
+    return levelMapping.count(levelHandle);
+}
+
+int GetLevelMesh(const MCLevelHandle levelHandle, Triangle **triangleArr, unsigned int *faces)
+{
+    std::vector<Triangle> triangeVec;
+    auto it = levelMapping.find(levelHandle);
+    if (it == levelMapping.end() || !instanceMapping[it->second->instance]->GetLevelMesh(it->second->level, triangeVec))
+    {
+        *triangleArr = nullptr;
+        *faces = 0;
+        return 0;
+    }
+
+    *triangleArr = new Triangle[triangeVec.size()];
+    memcpy(*triangleArr, triangeVec.data(), sizeof(Triangle) * triangeVec.size());
+    *faces = static_cast<unsigned int>(triangeVec.size());
+    return 1;
+}
+
+int GetLevelIndexedMesh(const MCLevelHandle levelHandle, fPoint **vertexArr, unsigned int *vertexCount, unsigned int **indexArr, unsigned int *indexCount)
+{
+    std::vector<fPoint> vertexVec;
+    std::vector<unsigned int> indexVec;
+    auto it = levelMapping.find(levelHandle);
+    if (it == levelMapping.end() || !instanceMapping[it->second->instance]->GetLevelIndexedMesh(it->second->level, vertexVec, indexVec))
+    {
+        *vertexArr = nullptr;
+        *vertexCount = 0;
+        *indexArr = nullptr;
+        *indexCount = 0;
+        return 0;
+    }
+
+    *vertexArr = new fPoint[vertexVec.size()];
+    memcpy(*vertexArr, vertexVec.data(), sizeof(fPoint) * vertexVec.size());
+    *vertexCount = static_cast<unsigned int>(vertexVec.size());
+    *indexArr = new unsigned int[indexVec.size()];
+    memcpy(*indexArr, indexVec.data(), sizeof(unsigned int) * indexVec.size());
+    *indexCount = static_cast<unsigned int>(indexVec.size());
+    return 1;
+}
+
+int SelectLevel(const MCLevelHandle levelHandle)
+{
+    auto it = levelMapping.find(levelHandle);
+    if (it == levelMapping.end())
+    {
+        return 0;
+    }
+    return static_cast<int>(instanceMapping[it->second->instance]->SelectLevel(it->second->level));
+}
+
+int PatchVolume(const MCHandle handle, const uPoint *first, const Dimension *size, const char *points)
+{
+    return static_cast<int>(instanceMapping[handle]->PatchVolume(*first, *size, reinterpret_cast<const uint8_t *>(points)));
+}
+
+void MarchChunked(const MCHandle handle, const unsigned int isoSurface, const unsigned int threadCount)
+{
+    instanceMapping[handle]->MarchChunked(InstanceIsoSurface(handle, isoSurface), threadCount);
+}
+
+void MarchChunkedValue(const MCHandle handle, const float isoSurface, const unsigned int threadCount)
+{
+    instanceMapping[handle]->MarchChunkedValue(isoSurface, threadCount);
+}
+
+MCChunkIterator CreateChunkIterator(const MCHandle handle)
+{
+    auto cursor = std::make_unique<ChunkCursor>(ChunkCursor{handle, 0});
+    auto iterator = reinterpret_cast<MCChunkIterator>(cursor.get());
+
+    chunkIteratorMapping.insert(std::pair<MCChunkIterator, std::unique_ptr<ChunkCursor>>(
+        iterator,
+        std::move(cursor)));
+
+    return iterator;
+}
+
+int NextChunk(const MCChunkIterator iterator, MCChunkInfo *info)
+{
+    auto it = chunkIteratorMapping.find(iterator);
+    if (it == chunkIteratorMapping.end())
+    {
+        return 0;
+    }
+
+    auto &cursor = *it->second;
+    const auto &instance = instanceMapping[cursor.instance];
+    while (cursor.next < instance->GetChunkCount() && instance->IsChunkEmpty(cursor.next))
+    {
+        ++cursor.next;
+    }
+    if (cursor.next >= instance->GetChunkCount())
+    {
+        return 0;
+    }
+
+    size_t vertexCount, indexCount;
+    info->chunk = cursor.next;
+    instance->GetChunkRegion(cursor.next, info->firstCube, info->cubeCount);
+    instance->GetChunkBoundingBox(cursor.next, info->boundingMax, info->boundingMin);
+    instance->GetChunkMeshSize(cursor.next, vertexCount, indexCount);
+    info->vertexCount = static_cast<unsigned int>(vertexCount);
+    info->indexCount = static_cast<unsigned int>(indexCount);
+
+    ++cursor.next;
+    return 1;
+}
+
+void ReleaseChunkIterator(const MCChunkIterator iterator)
+{
+    chunkIteratorMapping.erase(iterator);
+}
+
+int GetChunkIndexedMesh(const MCHandle handle, const unsigned int chunk, fPoint **vertexArr, unsigned int *vertexCount, unsigned int **indexArr, unsigned int *indexCount)
+{
+    std::vector<fPoint> vertexVec;
+    std::vector<unsigned int> indexVec;
+    if (!instanceMapping[handle]->GetChunkIndexedMesh(chunk, vertexVec, indexVec))
+    {
+        *vertexArr = nullptr;
+        *vertexCount = 0;
+        *indexArr = nullptr;
+        *indexCount = 0;
+        return 0;
+    }
+
+    *vertexArr = new fPoint[vertexVec.size()];
+    memcpy(*vertexArr, vertexVec.data(), sizeof(fPoint) * vertexVec.size());
+    *vertexCount = static_cast<unsigned int>(vertexVec.size());
+    *indexArr = new unsigned int[indexVec.size()];
+    memcpy(*indexArr, indexVec.data(), sizeof(unsigned int) * indexVec.size());
+    *indexCount = static_cast<unsigned int>(indexVec.size());
+    return 1;
+}
+
+int BuildSpanSpaceIndex(const MCHandle handle, const unsigned long long memoryBudget)
+{
+    return static_cast<int>(instanceMapping[handle]->BuildSpanSpaceIndex(static_cast<size_t>(memoryBudget)));
+}
+
+void ReleaseSpanSpaceIndex(const MCHandle handle)
+{
+    instanceMapping[handle]->ReleaseSpanSpaceIndex();
+}
+
 void GetCurrentMesh(const MCHandle handle, Triangle **triangleArr, unsigned int *faces)
 {
     std::vector<Triangle> triangeVec;
@@ -79,17 +376,96 @@ void GetCurrentMeshNormalized(const MCHandle handle, Triangle **triangleArr, uns
     *faces = static_cast<unsigned int>(triangeVec.size());
 }
 
+void ParallelGetCurrentMeshNormalized(const MCHandle handle, Triangle **triangleArr, unsigned int *faces, const unsigned int threadCount)
+{
+    std::vector<Triangle> triangeVec;
+    instanceMapping[handle]->GetCurrentMeshNormalized(triangeVec, threadCount);
+    *triangleArr = new Triangle[triangeVec.size()];
+    memcpy(*triangleArr, triangeVec.data(), sizeof(Triangle) * triangeVec.size());
+    *faces = static_cast<unsigned int>(triangeVec.size());
+}
+
+void NormalizeCurrentMesh(const MCHandle handle, const unsigned int threadCount)
+{
+    instanceMapping[handle]->NormalizeCurrentMesh(threadCount);
+}
+
 void GetMeshNormal(const Triangle *inTri, const unsigned facesCount, fPoint **outNorm, unsigned int *normCount)
 {
-    std::vector<Triangle> triangeVec(facesCount);
-    memcpy(triangeVec.data(), inTri, facesCount * sizeof(Triangle));
+    /** Calculated from the caller's triangles straight into the array handed out*/
+    *outNorm = new fPoint[facesCount];
+    MarchingCube::CalculateFaceNormals(inTri, facesCount, *outNorm, 1);
+    *normCount = facesCount;
+}
+
+unsigned int CalculateFaceNormals(const Triangle *inTri, const unsigned int facesCount, fPoint *outNorm, const unsigned int threadCount)
+{
+    return static_cast<unsigned int>(MarchingCube::CalculateFaceNormals(inTri, facesCount, outNorm, threadCount));
+}
+
+void SetGradientNormals(const MCHandle handle, const int isEnabled)
+{
+    instanceMapping[handle]->SetGradientNormals(isEnabled != 0);
+}
+
+int GetCurrentVertexNormals(const MCHandle handle, fPoint **outNorm, unsigned int *normCount, const int isNormalized)
+{
+    std::vector<fPoint> norms;
+    if (!instanceMapping[handle]->GetCurrentVertexNormals(norms, isNormalized != 0))
+    {
+        return 0;
+    }
+
+    *outNorm = new fPoint[norms.size()];
+    memcpy(*outNorm, norms.data(), norms.size() * sizeof(fPoint));
+    *normCount = static_cast<unsigned int>(norms.size());
+    return 1;
+}
 
+int GetCurrentMeshVertexNormals(const MCHandle handle, fPoint **outNorm, unsigned int *normCount, const int isNormalized)
+{
     std::vector<fPoint> norms;
-    MarchingCube::GetMeshNormal(triangeVec, norms);
+    if (!instanceMapping[handle]->GetCurrentMeshVertexNormals(norms, isNormalized != 0))
+    {
+        return 0;
+    }
 
     *outNorm = new fPoint[norms.size()];
     memcpy(*outNorm, norms.data(), norms.size() * sizeof(fPoint));
     *normCount = static_cast<unsigned int>(norms.size());
+    return 1;
+}
+
+void GetCurrentIndexedMesh(const MCHandle handle, fPoint **vertexArr, unsigned int *vertexCount, unsigned int **indexArr, unsigned int *indexCount)
+{
+    std::vector<fPoint> vertexVec;
+    std::vector<unsigned int> indexVec;
+    instanceMapping[handle]->GetCurrentIndexedMesh(vertexVec, indexVec);
+    *vertexArr = new fPoint[vertexVec.size()];
+    memcpy(*vertexArr, vertexVec.data(), sizeof(fPoint) * vertexVec.size());
+    *vertexCount = static_cast<unsigned int>(vertexVec.size());
+    *indexArr = new unsigned int[indexVec.size()];
+    memcpy(*indexArr, indexVec.data(), sizeof(unsigned int) * indexVec.size());
+    *indexCount = static_cast<unsigned int>(indexVec.size());
+}
+
+void GetCurrentIndexedMeshNormalized(const MCHandle handle, fPoint **vertexArr, unsigned int *vertexCount, unsigned int **indexArr, unsigned int *indexCount)
+{
+    std::vector<fPoint> vertexVec;
+    std::vector<unsigned int> indexVec;
+    instanceMapping[handle]->GetCurrentIndexedMeshNormalized(vertexVec, indexVec);
+    *vertexArr = new fPoint[vertexVec.size()];
+    memcpy(*vertexArr, vertexVec.data(), sizeof(fPoint) * vertexVec.size());
+    *vertexCount = static_cast<unsigned int>(vertexVec.size());
+    *indexArr = new unsigned int[indexVec.size()];
+    memcpy(*indexArr, indexVec.data(), sizeof(unsigned int) * indexVec.size());
+    *indexCount = static_cast<unsigned int>(indexVec.size());
+}
+
+void ReleaseCurrentIndices(unsigned int **indexArr)
+{
+    delete[] (*indexArr);
+    *indexArr = nullptr;
 }
 
 void ReleaseCurrentPoint(fPoint **inPoi)
@@ -109,6 +485,42 @@ void WriteCurrentMeshToObj(const MCHandle handle, const char *filename)
     instanceMapping[handle]->WriteCurrentMeshToObj(filename);
 }
 
+int ParallelWriteCurrentMeshToObj(const MCHandle handle, const char *filename, const unsigned int threadCount)
+{
+    return static_cast<int>(instanceMapping[handle]->WriteCurrentMeshToObj(filename, threadCount));
+}
+
+int WriteCurrentMeshToPly(const MCHandle handle, const char *filename, const int withNormals)
+{
+    return static_cast<int>(instanceMapping[handle]->WriteCurrentMeshToPly(filename, withNormals != 0));
+}
+
+int WriteCurrentMeshToStl(const MCHandle handle, const char *filename)
+{
+    return static_cast<int>(instanceMapping[handle]->WriteCurrentMeshToStl(filename));
+}
+
+int WriteCurrentMeshToQuantized(const MCHandle handle, const char *filename, const int isCompressed)
+{
+    return static_cast<int>(instanceMapping[handle]->WriteCurrentMeshToQuantized(filename, isCompressed != 0));
+}
+
+int ReadQuantizedMesh(const char *filename, Triangle **triangleArr, unsigned int *faces)
+{
+    std::vector<Triangle> triangeVec;
+    if (!QuantizedMesh::Read(filename, triangeVec))
+    {
+        *triangleArr = nullptr;
+        *faces = 0;
+        return 0;
+    }
+
+    *triangleArr = new Triangle[triangeVec.size()];
+    memcpy(*triangleArr, triangeVec.data(), sizeof(Triangle) * triangeVec.size());
+    *faces = static_cast<unsigned int>(triangeVec.size());
+    return 1;
+}
+
 int ParseFileName(const char *filename, Dimension *dimension)
 {
     return static_cast<int>(MarchingCube::ParseFileName(filename, *dimension));
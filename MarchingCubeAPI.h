@@ -5,6 +5,27 @@
 
 typedef unsigned long long MCHandle;
 
+/** One isosurface of a MarchMulti, valid until the next MarchMulti of its instance or the release of the instance*/
+typedef unsigned long long MCLevelHandle;
+
+/** Walks the non-empty mesh chunks of an instance, see CreateChunkIterator*/
+typedef unsigned long long MCChunkIterator;
+
+/** A mesh chunk => its offset in the chunk grid, the cubes it covers, its bounding box and the size of its mesh*/
+typedef struct _mcchunkinfo
+{
+    unsigned int chunk;
+    uPoint firstCube;
+    Dimension cubeCount;
+    fPoint boundingMax;
+    fPoint boundingMin;
+    unsigned int vertexCount;
+    unsigned int indexCount;
+} MCChunkInfo;
+
+/** triangles of the batch (only valid during the call), triangle count, user data given to MarchToSink*/
+typedef void (*MCMeshSink)(const Triangle *, const unsigned int, void *);
+
 #ifdef BUILDMCAPI
 #define EXPORTMCAPI __declspec(dllexport)
 #else
@@ -16,23 +37,106 @@ extern "C"
 {
 #endif
 
-    /** MarchingCubes API*/
+    /**
+     * MarchingCubes API, the points are of the voxelType of the dimension (VOXEL_* of Types.h),
+     * a zeroed voxelType is 8 bit. The unsigned isovalues are taken as 8 bit by 8 bit instances
+     */
     EXPORTMCAPI MCHandle CreateMarchingCubeInstance(const char *, const Dimension *);
+    /** buffer, buffer size in bytes, dimension => returns 0 if the voxel type is unknown*/
     EXPORTMCAPI MCHandle CreateMarchingCubeInstanceFromBuffer(const char *, const int, const Dimension *);
+    /** The raw file is read two slices at a time by every March instead of being loaded, for volumes larger than the memory*/
+    EXPORTMCAPI MCHandle CreateMarchingCubeStreamInstance(const char *, const Dimension *);
     EXPORTMCAPI void ReleaseMarchingCubeInstance(const MCHandle);
     EXPORTMCAPI int CheckIsMCInstanceExists(const MCHandle);
 
     EXPORTMCAPI void March(const MCHandle, const unsigned int);
+    /** isovalue, thread count (0 => one thread per hardware core)*/
+    EXPORTMCAPI void ParallelMarch(const MCHandle, const unsigned int, const unsigned int);
     EXPORTMCAPI void DefaultMarch(const MCHandle);
+    /** isovalue, sink, user data => the triangles are pushed to the sink instead of being kept, returns 0 if the raw file cannot be read*/
+    EXPORTMCAPI int MarchToSink(const MCHandle, const unsigned int, MCMeshSink, void *);
+
+    /** VOXEL_* type of the points of the instance*/
+    EXPORTMCAPI unsigned int GetVoxelType(const MCHandle);
+    /** The *Value marches take the isovalue in the unit of the points, e.g. -500 for an int16 CT volume in Hounsfield units*/
+    EXPORTMCAPI void ParallelMarchValue(const MCHandle, const float, const unsigned int);
+    EXPORTMCAPI int MarchValueToSink(const MCHandle, const float, MCMeshSink, void *);
+    EXPORTMCAPI void MarchMultiValues(const MCHandle, const float *, const unsigned int, const unsigned int, MCLevelHandle *);
+    EXPORTMCAPI void MarchChunkedValue(const MCHandle, const float, const unsigned int);
+
+    /**
+     * isovalues, isovalue count, thread count (0 => one thread per hardware core), out level handles (isovalue count of them)
+     * => every isosurface is extracted in one pass over the volume, the current mesh is not touched
+     */
+    EXPORTMCAPI void MarchMulti(const MCHandle, const unsigned int *, const unsigned int, const unsigned int, MCLevelHandle *);
+    EXPORTMCAPI int CheckIsLevelExists(const MCLevelHandle);
+    /** The level getters return 0 if the level handle is no longer valid*/
+    EXPORTMCAPI int GetLevelMesh(const MCLevelHandle, Triangle **, unsigned int *);
+    EXPORTMCAPI int GetLevelIndexedMesh(const MCLevelHandle, fPoint **, unsigned int *, unsigned int **, unsigned int *);
+    /** Copy the level into the current mesh of its instance, so the current mesh getters and writers work on it*/
+    EXPORTMCAPI int SelectLevel(const MCLevelHandle);
+
+    /**
+     * first point of the box, box size, points of the box (x fastest, voxel type of the instance) => overwrite the points of the box,
+     * the current mesh is updated by re-marching only the chunks around the box, returns 0 if the box does not fit the volume
+     */
+    EXPORTMCAPI int PatchVolume(const MCHandle, const uPoint *, const Dimension *, const char *);
+
+    /** isovalue, thread count (0 => one thread per hardware core) => the mesh is made as chunks of 32^3 cubes, read them by a chunk iterator*/
+    EXPORTMCAPI void MarchChunked(const MCHandle, const unsigned int, const unsigned int);
+    /** The iterator starts before the first non-empty chunk of the current chunks of the instance*/
+    EXPORTMCAPI MCChunkIterator CreateChunkIterator(const MCHandle);
+    /** Move to the next non-empty chunk and describe it, returns 0 once every chunk has been visited*/
+    EXPORTMCAPI int NextChunk(const MCChunkIterator, MCChunkInfo *);
+    EXPORTMCAPI void ReleaseChunkIterator(const MCChunkIterator);
+    /** chunk offset from MCChunkInfo, out vertices, out vertex count, out indices, out index count, returns 0 if the chunk does not exist*/
+    EXPORTMCAPI int GetChunkIndexedMesh(const MCHandle, const unsigned int, fPoint **, unsigned int *, unsigned int **, unsigned int *);
+
+    /** memory budget in bytes, returns 0 if the index does not fit the budget*/
+    EXPORTMCAPI int BuildSpanSpaceIndex(const MCHandle, const unsigned long long);
+    EXPORTMCAPI void ReleaseSpanSpaceIndex(const MCHandle);
 
     EXPORTMCAPI void GetCurrentMesh(const MCHandle, Triangle **, unsigned int *);
     EXPORTMCAPI void GetCurrentMeshNormalized(const MCHandle, Triangle **, unsigned int *);
     EXPORTMCAPI void GetMeshNormal(const Triangle *, const unsigned, fPoint **, unsigned int *);
+    /**
+     * triangles, face count, out normals (face count of them, owned by the caller), thread count (0 => one thread per hardware core)
+     * => unit normal of every face written straight into the buffer, returns the count of faces without area, their normal is (0, 0, 0)
+     */
+    EXPORTMCAPI unsigned int CalculateFaceNormals(const Triangle *, const unsigned int, fPoint *, const unsigned int);
+
+    /** 1 => the next marches make a normal per vertex from the volume gradient*/
+    EXPORTMCAPI void SetGradientNormals(const MCHandle, const int);
+    /**
+     * out normals (released by ReleaseCurrentPoint), out normal count, 1 => the normals of the normalized mesh,
+     * returns 0 if the current mesh has no gradient normals. One normal per vertex of GetCurrentIndexedMesh
+     */
+    EXPORTMCAPI int GetCurrentVertexNormals(const MCHandle, fPoint **, unsigned int *, const int);
+    /** As above, 3 normals per triangle in the order of GetCurrentMesh (for SetNorm of the drawler)*/
+    EXPORTMCAPI int GetCurrentMeshVertexNormals(const MCHandle, fPoint **, unsigned int *, const int);
+    /** thread count normalizing the vertices (0 => one thread per hardware core)*/
+    EXPORTMCAPI void ParallelGetCurrentMeshNormalized(const MCHandle, Triangle **, unsigned int *, const unsigned int);
+    /** Normalize the current mesh in place, thread count as above*/
+    EXPORTMCAPI void NormalizeCurrentMesh(const MCHandle, const unsigned int);
+
+    /** out vertices, out vertex count, out indices (3 per face), out index count*/
+    EXPORTMCAPI void GetCurrentIndexedMesh(const MCHandle, fPoint **, unsigned int *, unsigned int **, unsigned int *);
+    EXPORTMCAPI void GetCurrentIndexedMeshNormalized(const MCHandle, fPoint **, unsigned int *, unsigned int **, unsigned int *);
 
     EXPORTMCAPI void ReleaseCurrentMesh(Triangle **);
     EXPORTMCAPI void ReleaseCurrentPoint(fPoint **);
+    EXPORTMCAPI void ReleaseCurrentIndices(unsigned int **);
 
     EXPORTMCAPI void WriteCurrentMeshToObj(const MCHandle, const char *);
+    /** filename, thread count (0 => one thread per hardware core), returns 0 if the file cannot be written*/
+    EXPORTMCAPI int ParallelWriteCurrentMeshToObj(const MCHandle, const char *, const unsigned int);
+    /** filename, 1 => with per vertex normals, returns 0 if the file cannot be written*/
+    EXPORTMCAPI int WriteCurrentMeshToPly(const MCHandle, const char *, const int);
+    EXPORTMCAPI int WriteCurrentMeshToStl(const MCHandle, const char *);
+    /** filename, 1 => pack the sections, returns 0 if the file cannot be written*/
+    EXPORTMCAPI int WriteCurrentMeshToQuantized(const MCHandle, const char *, const int);
+    /** filename, out triangles (released by ReleaseCurrentMesh), out face count, returns 0 if the file is not a valid quantized mesh*/
+    EXPORTMCAPI int ReadQuantizedMesh(const char *, Triangle **, unsigned int *);
     EXPORTMCAPI int ParseFileName(const char *, Dimension *);
 #ifdef __cplusplus
 }
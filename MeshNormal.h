@@ -0,0 +1,41 @@
+#ifndef __MARCHING_CUBE_MESH_NORMAL_H__
+#define __MARCHING_CUBE_MESH_NORMAL_H__
+
+#include "Types.h"
+
+#include <math.h>
+
+/** Face normal helpers shared by the marching cube, the mesh writer and the drawler, header only so every library has its own copy*/
+namespace MeshNormal
+{
+    /** Cross product of the two edges leaving v0, it follows the winding and its length is twice the area of the face*/
+    inline fPoint FaceCross(const fPoint &v0, const fPoint &v1, const fPoint &v2)
+    {
+        const fPoint vector0{v1.x - v0.x, v1.y - v0.y, v1.z - v0.z};
+        const fPoint vector1{v2.x - v0.x, v2.y - v0.y, v2.z - v0.z};
+        return fPoint{
+            vector0.y * vector1.z - vector0.z * vector1.y,
+            vector0.z * vector1.x - vector0.x * vector1.z,
+            vector0.x * vector1.y - vector0.y * vector1.x};
+    }
+
+    /** Scale a vector to unit length, a zero vector stays zero instead of becoming NaN*/
+    inline fPoint Unit(const fPoint &v)
+    {
+        const float length = sqrtf(v.x * v.x + v.y * v.y + v.z * v.z);
+        if (length > 0)
+        {
+            const float inverse = 1 / length;
+            return fPoint{v.x * inverse, v.y * inverse, v.z * inverse};
+        }
+        return v;
+    }
+
+    /** Unit normal of a face by its winding, (0, 0, 0) for a face without area*/
+    inline fPoint FaceNormal(const Triangle &face)
+    {
+        return Unit(FaceCross(face.v0, face.v1, face.v2));
+    }
+}
+
+#endif
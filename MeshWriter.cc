@@ -0,0 +1,305 @@
+#include "MeshWriter.h"
+#include "MeshNormal.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <filesystem>
+#include <thread>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+/** The binary formats are little endian and written from memory as is*/
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "MeshWriter writes the binary formats in host byte order, which must be little endian"
+#endif
+
+/** Lines formatted into one buffer before it is written*/
+#define LINES_PER_CHUNK (1u << 16)
+
+/** Longest OBJ line: "v " and 3 shortest round trip floats (at most 15 characters each) with their separators*/
+#define MAX_OBJ_LINE 64
+
+bool MeshWriter::WriteObj(const std::string &objFilename, const std::vector<fPoint> &vertices, const std::vector<unsigned int> &indices, const unsigned int inputThreadCount)
+{
+    FILE *outFile = fopen(std::filesystem::absolute(objFilename).string().c_str(), "wb");
+    if (!outFile)
+    {
+        return false;
+    }
+
+    const std::string commentsString =
+        "# OBJ file generated by MarchingCube Algorithm\n"
+        "# Face Count = " +
+        std::to_string(indices.size() / 3) + "\n";
+    bool isWritten = fwrite(commentsString.data(), 1, commentsString.size(), outFile) == commentsString.size();
+
+    const size_t lineCount = vertices.size() + indices.size() / 3;
+    const size_t chunkCount = (lineCount + LINES_PER_CHUNK - 1) / LINES_PER_CHUNK;
+
+    /** 0 means one thread per hardware core*/
+    unsigned int threadCount = inputThreadCount;
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threadCount = static_cast<unsigned int>(std::max<size_t>(1, std::min<size_t>(threadCount, chunkCount)));
+
+    /**
+     * Every thread formats one chunk of lines into its own buffer,
+     * then the buffers are written in chunk order and the threads move on to the next round of chunks
+     */
+    std::vector<std::vector<char>> buffers(threadCount, std::vector<char>(static_cast<size_t>(LINES_PER_CHUNK) * MAX_OBJ_LINE));
+    std::vector<char *> bufferEnds(threadCount);
+
+    for (size_t roundBegin = 0; isWritten && roundBegin < chunkCount; roundBegin += threadCount)
+    {
+        const unsigned int roundChunks = static_cast<unsigned int>(std::min<size_t>(threadCount, chunkCount - roundBegin));
+
+        auto format = [&](const unsigned int i)
+        {
+            const size_t begin = (roundBegin + i) * LINES_PER_CHUNK;
+            const size_t end = std::min(lineCount, begin + LINES_PER_CHUNK);
+            bufferEnds[i] = FormatObjLines(vertices, indices, begin, end, buffers[i].data());
+        };
+
+        std::vector<std::thread> workers;
+        for (unsigned int i = 1; i < roundChunks; ++i)
+        {
+            workers.emplace_back(format, i);
+        }
+        format(0);
+        for (auto &w : workers)
+        {
+            w.join();
+        }
+
+        for (unsigned int i = 0; isWritten && i < roundChunks; ++i)
+        {
+            const size_t size = static_cast<size_t>(bufferEnds[i] - buffers[i].data());
+            isWritten = fwrite(buffers[i].data(), 1, size, outFile) == size;
+        }
+    }
+
+    return fclose(outFile) == 0 && isWritten;
+}
+
+char *MeshWriter::FormatObjLines(const std::vector<fPoint> &vertices, const std::vector<unsigned int> &indices, const size_t begin, const size_t end, char *out)
+{
+    /** The buffer holds MAX_OBJ_LINE characters per line, the bound is never reached*/
+    char *const outEnd = out + (end - begin) * MAX_OBJ_LINE;
+
+    auto putFloat = [&](const float value)
+    {
+        out = std::to_chars(out, outEnd, value).ptr;
+    };
+
+    /** OBJ indices start from 1*/
+    auto putIndex = [&](const unsigned int index)
+    {
+        out = std::to_chars(out, outEnd, static_cast<unsigned long long>(index) + 1).ptr;
+    };
+
+    size_t line = begin;
+    for (; line < end && line < vertices.size(); ++line)
+    {
+        const auto &v = vertices[line];
+        memcpy(out, "v ", 2);
+        out += 2;
+        putFloat(v.x);
+        *out++ = ' ';
+        putFloat(v.y);
+        *out++ = ' ';
+        putFloat(v.z);
+        *out++ = '\n';
+    }
+
+    for (; line < end; ++line)
+    {
+        const unsigned int *face = indices.data() + (line - vertices.size()) * 3;
+        memcpy(out, "f ", 2);
+        out += 2;
+        putIndex(face[0]);
+        *out++ = ' ';
+        putIndex(face[1]);
+        *out++ = ' ';
+        putIndex(face[2]);
+        *out++ = '\n';
+    }
+
+    return out;
+}
+
+bool MeshWriter::WritePly(const std::string &plyFilename, const std::vector<fPoint> &vertices, const std::vector<fPoint> &normals, const std::vector<unsigned int> &indices)
+{
+    const bool hasNormals = !normals.empty();
+    if (hasNormals && normals.size() != vertices.size())
+    {
+        return false;
+    }
+
+    const size_t faceCount = indices.size() / 3;
+
+    std::string header = "ply\n"
+                         "format binary_little_endian 1.0\n"
+                         "comment PLY file generated by MarchingCube Algorithm\n";
+    header += "element vertex " + std::to_string(vertices.size()) + "\n";
+    header += "property float x\nproperty float y\nproperty float z\n";
+    if (hasNormals)
+    {
+        header += "property float nx\nproperty float ny\nproperty float nz\n";
+    }
+    header += "element face " + std::to_string(faceCount) + "\n";
+    header += "property list uchar uint vertex_indices\nend_header\n";
+
+    std::vector<Segment> segments{{header.data(), header.size()}};
+
+    /** Without normals a vertex record is exactly an fPoint, the vertex storage is written as is*/
+    std::vector<fPoint> interleaved;
+    if (hasNormals)
+    {
+        interleaved.resize(vertices.size() * 2);
+        for (size_t i = 0; i < vertices.size(); ++i)
+        {
+            interleaved[i * 2] = vertices[i];
+            interleaved[i * 2 + 1] = normals[i];
+        }
+        segments.emplace_back(Segment{interleaved.data(), interleaved.size() * sizeof(fPoint)});
+    }
+    else
+    {
+        segments.emplace_back(Segment{vertices.data(), vertices.size() * sizeof(fPoint)});
+    }
+
+    /** Face record => uchar 3 then 3 uint indices, 13 bytes with no padding*/
+    const size_t faceBytes = 1 + 3 * sizeof(unsigned int);
+    std::vector<uint8_t> faces(faceCount * faceBytes);
+    for (size_t i = 0; i < faceCount; ++i)
+    {
+        uint8_t *record = faces.data() + i * faceBytes;
+        record[0] = 3;
+        memcpy(record + 1, indices.data() + i * 3, 3 * sizeof(unsigned int));
+    }
+    segments.emplace_back(Segment{faces.data(), faces.size()});
+
+    return WriteSegments(plyFilename, segments);
+}
+
+bool MeshWriter::WriteStl(const std::string &stlFilename, const std::vector<fPoint> &vertices, const std::vector<unsigned int> &indices)
+{
+    const size_t faceCount = indices.size() / 3;
+
+    /** The face count of binary STL is 32 bit*/
+    if (faceCount > 0xffffffffu)
+    {
+        return false;
+    }
+
+    /** 80 byte header then the face count*/
+    uint8_t header[84] = {};
+    const char title[] = "STL file generated by MarchingCube Algorithm";
+    memcpy(header, title, sizeof(title) - 1);
+    const auto count = static_cast<uint32_t>(faceCount);
+    memcpy(header + 80, &count, sizeof(count));
+
+    /** Face record => normal, v0, v1, v2 and a 16 bit attribute, 50 bytes with no padding*/
+    const size_t faceBytes = 4 * sizeof(fPoint) + sizeof(uint16_t);
+    std::vector<uint8_t> faces(faceCount * faceBytes);
+    for (size_t i = 0; i < faceCount; ++i)
+    {
+        const fPoint &v0 = vertices[indices[i * 3]];
+        const fPoint &v1 = vertices[indices[i * 3 + 1]];
+        const fPoint &v2 = vertices[indices[i * 3 + 2]];
+
+        /** A degenerate face keeps a zero normal, readers recalculate it from the winding*/
+        const fPoint normal = MeshNormal::Unit(MeshNormal::FaceCross(v0, v1, v2));
+
+        uint8_t *record = faces.data() + i * faceBytes;
+        memcpy(record, &normal, sizeof(fPoint));
+        memcpy(record + sizeof(fPoint), &v0, sizeof(fPoint));
+        memcpy(record + sizeof(fPoint) * 2, &v1, sizeof(fPoint));
+        memcpy(record + sizeof(fPoint) * 3, &v2, sizeof(fPoint));
+        memset(record + sizeof(fPoint) * 4, 0, sizeof(uint16_t));
+    }
+
+    return WriteSegments(stlFilename, {{header, sizeof(header)}, {faces.data(), faces.size()}});
+}
+
+bool MeshWriter::WriteSegments(const std::string &filename, const std::vector<Segment> &segments)
+{
+    const auto path = std::filesystem::absolute(filename).string();
+
+#ifdef _WIN32
+    FILE *outFile = fopen(path.c_str(), "wb");
+    if (!outFile)
+    {
+        return false;
+    }
+
+    /** Unbuffered, every segment is one large write*/
+    setvbuf(outFile, nullptr, _IONBF, 0);
+
+    bool isWritten = true;
+    for (const auto &segment : segments)
+    {
+        if (isWritten && segment.size)
+        {
+            isWritten = fwrite(segment.data, 1, segment.size, outFile) == segment.size;
+        }
+    }
+
+    return fclose(outFile) == 0 && isWritten;
+#else
+    const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    std::vector<iovec> pieces;
+    for (const auto &segment : segments)
+    {
+        if (segment.size)
+        {
+            pieces.emplace_back(iovec{const_cast<void *>(segment.data), segment.size});
+        }
+    }
+
+    /** writev may stop early (signals, the 2 GB cap of a single write), carry on from where it stopped*/
+    size_t first = 0;
+    bool isWritten = true;
+    while (isWritten && first < pieces.size())
+    {
+        const int pieceCount = static_cast<int>(std::min<size_t>(pieces.size() - first, IOV_MAX));
+        const ssize_t written = writev(fd, pieces.data() + first, pieceCount);
+        if (written < 0)
+        {
+            isWritten = errno == EINTR;
+            continue;
+        }
+
+        size_t left = static_cast<size_t>(written);
+        while (first < pieces.size() && left >= pieces[first].iov_len)
+        {
+            left -= pieces[first].iov_len;
+            ++first;
+        }
+        if (left)
+        {
+            pieces[first].iov_base = static_cast<uint8_t *>(pieces[first].iov_base) + left;
+            pieces[first].iov_len -= left;
+        }
+    }
+
+    return close(fd) == 0 && isWritten;
+#endif
+}
@@ -0,0 +1,41 @@
+#ifndef __MARCHING_CUBE_MESH_WRITER_H__
+#define __MARCHING_CUBE_MESH_WRITER_H__
+
+#include "Types.h"
+
+#include <vector>
+#include <string>
+
+/**
+ * Writes an indexed mesh to disk,
+ * OBJ lines are formatted into large buffers with std::to_chars and written a buffer at a time,
+ * binary formats are written straight from the mesh storage wherever the layout allows it
+ */
+class MeshWriter
+{
+public:
+    /** filename, vertices, indices (3 per face), thread count formatting the lines (0 => one thread per hardware core), false if the file cannot be written*/
+    static bool WriteObj(const std::string &, const std::vector<fPoint> &, const std::vector<unsigned int> &, const unsigned int);
+
+    /** Binary little endian PLY => filename, vertices, vertex normals (empty => no normals), indices (3 per face)*/
+    static bool WritePly(const std::string &, const std::vector<fPoint> &, const std::vector<fPoint> &, const std::vector<unsigned int> &);
+
+    /** Binary STL => filename, vertices, indices (3 per face), the face normals are calculated from the winding*/
+    static bool WriteStl(const std::string &, const std::vector<fPoint> &, const std::vector<unsigned int> &);
+
+private:
+    /** A piece of the file written as is*/
+    struct Segment
+    {
+        const void *data;
+        size_t size;
+    };
+
+    /** Write the segments in order with as few system calls as possible, writev where it is available*/
+    static bool WriteSegments(const std::string &, const std::vector<Segment> &);
+
+    /** Format the OBJ lines [begin, end), the vertex lines come first then the face lines, returns the end of the text*/
+    static char *FormatObjLines(const std::vector<fPoint> &, const std::vector<unsigned int> &, const size_t, const size_t, char *);
+};
+
+#endif
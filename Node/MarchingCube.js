@@ -57,6 +57,7 @@ var privateMap = new WeakMap();
  * @property {number} width -  width of raw file
  * @property {number} height -  height of raw file
  * @property {number} depth -  depth of raw file
+ * @property {number} [voxelType] - type of the points of raw file, one of MarchingCube.VoxelType, UINT8 if omitted
  */
 
 /**
@@ -156,8 +157,9 @@ MarchingCube.prototype.ReleaseMarchingCubeInstance = function () {
  * March the volume to construct the 3d surfaces
  * @memberof MarchingCube
  * @param {number} isoValue - The isovalue use to march
+ * @param {number} [threadCount] - Number of threads to march with, 0 uses every hardware core, omit to march on one thread
  */
-MarchingCube.prototype.March = function (isoValue) {
+MarchingCube.prototype.March = function (isoValue, threadCount) {
   var privateVariable = privateMap.get(this);
   if (
     !nativeBinding.CheckIsMCInstanceExists(privateVariable.marchingCubeHandle)
@@ -173,7 +175,18 @@ MarchingCube.prototype.March = function (isoValue) {
     throw new TypeError("Isovalue cannot be greater than 255 or negative");
   }
 
-  nativeBinding.March(privateVariable.marchingCubeHandle, isoValue);
+  if (threadCount === undefined) {
+    nativeBinding.March(privateVariable.marchingCubeHandle, isoValue);
+  } else {
+    if (threadCount < 0) {
+      throw new TypeError("Thread count cannot be negative");
+    }
+    nativeBinding.March(
+      privateVariable.marchingCubeHandle,
+      isoValue,
+      threadCount
+    );
+  }
   privateVariable.isMarchCalled = true;
 };
 
@@ -225,9 +238,23 @@ MarchingCube.prototype.WriteCurrentMeshToObj = function (outFilename) {
   );
 };
 
+/**
+ * Types of the points of a raw file, the voxelType of a Dimension
+ * @memberof MarchingCube
+ * @static
+ * @readonly
+ * @enum {number}
+ */
+MarchingCube.VoxelType = Object.freeze({
+  UINT8: 0,
+  UINT16: 1,
+  INT16: 2,
+  FLOAT32: 3,
+});
+
 /**
  * Parse filename into Dimension struct, the filename must contains substring like '<...>width_height_depth<...>' format,
- * or it will raise a error
+ * optionally followed by the voxel type '_u8', '_u16', '_s16' or '_f32', or it will raise a error
  * @memberof MarchingCube
  * @static
  * @param {string} filename - Filename you wanna to parse
@@ -169,10 +169,24 @@ Napi::Value Node_CreateMarchingCubeInstance(const Napi::CallbackInfo &info)
         return env.Null();
     }
 
+    /** The voxel type is optional, a dimension without one is an 8 bit volume*/
+    unsigned int voxelType = VOXEL_UINT8;
+    auto dimObjType = dimObj.Get("voxelType");
+    if (!dimObjType.IsUndefined())
+    {
+        if (!dimObjType.IsNumber())
+        {
+            Napi::TypeError::New(env, "Wrong Arguments, \"voxelType\" of Dimension object excepted one number").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        voxelType = dimObjType.As<Napi::Number>().Uint32Value();
+    }
+
     Dimension dimension{
         dimObjw.As<Napi::Number>().Uint32Value(),
         dimObjh.As<Napi::Number>().Uint32Value(),
         dimObjd.As<Napi::Number>().Uint32Value(),
+        voxelType,
     };
 
     MCHandle handle;
@@ -264,10 +278,23 @@ Napi::Value Node_March(const Napi::CallbackInfo &info)
         return env.Null();
     }
 
+    if (info.Length() > 2 && !info[2].IsNumber())
+    {
+        Napi::TypeError::New(env, "Wrong Arguments, position 2 excepted one number").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
     const auto handle = static_cast<MCHandle>(std::stoull(info[0].As<Napi::String>().Utf8Value()));
     auto isoValue = info[1].As<Napi::Number>().Uint32Value();
 
-    March(handle, isoValue);
+    if (info.Length() > 2)
+    {
+        ParallelMarch(handle, isoValue, info[2].As<Napi::Number>().Uint32Value());
+    }
+    else
+    {
+        March(handle, isoValue);
+    }
 
     return env.Null();
 }
@@ -396,11 +423,12 @@ Napi::Value Node_ParseFileName(const Napi::CallbackInfo &info)
         jsDimensionStruct.Set("width", dimension.width);
         jsDimensionStruct.Set("height", dimension.height);
         jsDimensionStruct.Set("depth", dimension.depth);
+        jsDimensionStruct.Set("voxelType", dimension.voxelType);
         return jsDimensionStruct;
     }
     else
     {
-        Napi::Error::New(env, "Filename is not suitable for format \"width_height_depth\"").ThrowAsJavaScriptException();
+        Napi::Error::New(env, "Filename is not suitable for format \"width_height_depth[_type]\"").ThrowAsJavaScriptException();
         return env.Null();
     }
 }
@@ -0,0 +1,450 @@
+#include "QuantizedMesh.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "QuantizedMesh reads and writes the container in host byte order, which must be little endian"
+#endif
+
+#define QUANTIZED_MESH_VERSION 1u
+
+/** magic, version, counts, bounding box, two section descriptors*/
+#define HEADER_SIZE 80
+#define SECTION_DESCRIPTOR_SIZE 20
+
+/** Largest quantized coordinate*/
+#define QUANTIZED_MAX 65535.f
+
+/** Codec parameters => shortest match, hash table bits, farthest match, literals left at the end of a block*/
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 16
+#define LZ_MAX_OFFSET 65535
+#define LZ_LAST_LITERALS 8
+
+/** Most bytes a stored LZ byte expands to, a length byte of 255 adds 255 bytes of match*/
+#define LZ_MAX_EXPANSION 255
+
+/** Most bytes of an index, the zigzag of a delta between two 32 bit indices has 33 bits*/
+#define INDEX_MAX_BYTES 5
+
+namespace
+{
+    template <typename T>
+    inline void Put(std::vector<uint8_t> &out, const T value)
+    {
+        const auto *bytes = reinterpret_cast<const uint8_t *>(&value);
+        out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+
+    template <typename T>
+    inline T Get(const uint8_t *in)
+    {
+        T value;
+        memcpy(&value, in, sizeof(T));
+        return value;
+    }
+
+    /** A length nibble at 15 continues with bytes of 255 until a byte below 255*/
+    inline void PutLength(std::vector<uint8_t> &out, size_t length)
+    {
+        for (; length >= 255; length -= 255)
+        {
+            out.emplace_back(255);
+        }
+        out.emplace_back(static_cast<uint8_t>(length));
+    }
+
+    inline bool GetLength(const uint8_t *&in, const uint8_t *inEnd, size_t &length)
+    {
+        uint8_t byte;
+        do
+        {
+            if (in == inEnd)
+            {
+                return false;
+            }
+            byte = *in++;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+}
+
+bool QuantizedMesh::Write(const std::string &filename, const std::vector<fPoint> &vertices, const std::vector<unsigned int> &indices, const fPoint &max, const fPoint &min, const bool isCompressed)
+{
+    std::vector<uint8_t> rawSections[2];
+    EncodeVertices(vertices, max, min, rawSections[0]);
+    EncodeIndices(indices, rawSections[1]);
+
+    std::vector<uint8_t> packedSections[2];
+    SectionCodec codecs[2] = {CODEC_RAW, CODEC_RAW};
+    for (unsigned int i = 0; i < 2; ++i)
+    {
+        if (isCompressed)
+        {
+            Compress(rawSections[i].data(), rawSections[i].size(), packedSections[i]);
+            if (packedSections[i].size() < rawSections[i].size())
+            {
+                codecs[i] = CODEC_LZ;
+            }
+        }
+    }
+
+    std::vector<uint8_t> file;
+    file.reserve(HEADER_SIZE);
+    file.insert(file.end(), {'M', 'C', 'Q', 'M'});
+    Put<uint32_t>(file, QUANTIZED_MESH_VERSION);
+    Put<uint32_t>(file, static_cast<uint32_t>(vertices.size()));
+    Put<uint32_t>(file, static_cast<uint32_t>(indices.size()));
+    for (const float value : {max.x, max.y, max.z, min.x, min.y, min.z})
+    {
+        Put<float>(file, value);
+    }
+
+    for (unsigned int i = 0; i < 2; ++i)
+    {
+        const auto &stored = codecs[i] == CODEC_LZ ? packedSections[i] : rawSections[i];
+        Put<uint32_t>(file, codecs[i]);
+        Put<uint64_t>(file, rawSections[i].size());
+        Put<uint64_t>(file, stored.size());
+    }
+
+    FILE *outFile = fopen(std::filesystem::absolute(filename).string().c_str(), "wb");
+    if (!outFile)
+    {
+        return false;
+    }
+
+    bool isWritten = fwrite(file.data(), 1, file.size(), outFile) == file.size();
+    for (unsigned int i = 0; isWritten && i < 2; ++i)
+    {
+        const auto &stored = codecs[i] == CODEC_LZ ? packedSections[i] : rawSections[i];
+        isWritten = stored.empty() || fwrite(stored.data(), 1, stored.size(), outFile) == stored.size();
+    }
+
+    return fclose(outFile) == 0 && isWritten;
+}
+
+bool QuantizedMesh::ReadIndexed(const std::string &filename, std::vector<fPoint> &outVertices, std::vector<unsigned int> &outIndices)
+{
+    MappedFile file;
+    if (!file.Open(filename) || file.Size() < HEADER_SIZE)
+    {
+        return false;
+    }
+    file.AdviseSequential();
+
+    const uint8_t *data = file.Data();
+    if (memcmp(data, "MCQM", 4) != 0 || Get<uint32_t>(data + 4) != QUANTIZED_MESH_VERSION)
+    {
+        return false;
+    }
+
+    const auto vertexCount = Get<uint32_t>(data + 8);
+    const auto indexCount = Get<uint32_t>(data + 12);
+    const fPoint max{Get<float>(data + 16), Get<float>(data + 20), Get<float>(data + 24)};
+    const fPoint min{Get<float>(data + 28), Get<float>(data + 32), Get<float>(data + 36)};
+
+    /** Decode both sections back to their raw bytes, a raw section is used straight from the mapping*/
+    const uint8_t *sections[2];
+    uint64_t sectionSizes[2];
+    std::vector<uint8_t> unpacked[2];
+    uint64_t offset = HEADER_SIZE;
+
+    for (unsigned int i = 0; i < 2; ++i)
+    {
+        const uint8_t *descriptor = data + 40 + i * SECTION_DESCRIPTOR_SIZE;
+        const auto codec = Get<uint32_t>(descriptor);
+        const auto rawSize = Get<uint64_t>(descriptor + 4);
+        const auto storedSize = Get<uint64_t>(descriptor + 12);
+
+        if (storedSize > file.Size() - offset)
+        {
+            return false;
+        }
+
+        /** The sizes are checked before anything is allocated, a broken file must not ask for more than its counts and its bytes can hold*/
+        const bool isRawSizeValid = i == 0
+                                        ? rawSize == static_cast<uint64_t>(vertexCount) * 3 * sizeof(uint16_t)
+                                        : rawSize >= indexCount && rawSize <= static_cast<uint64_t>(indexCount) * INDEX_MAX_BYTES;
+        if (!isRawSizeValid || (codec == CODEC_LZ && rawSize > storedSize * LZ_MAX_EXPANSION))
+        {
+            return false;
+        }
+
+        if (codec == CODEC_RAW && storedSize == rawSize)
+        {
+            sections[i] = data + offset;
+        }
+        else if (codec == CODEC_LZ)
+        {
+            unpacked[i].resize(rawSize);
+            if (!Decompress(data + offset, storedSize, unpacked[i].data(), unpacked[i].size()))
+            {
+                return false;
+            }
+            sections[i] = unpacked[i].data();
+        }
+        else
+        {
+            return false;
+        }
+
+        sectionSizes[i] = rawSize;
+        offset += storedSize;
+    }
+
+    /** Undo the per axis deltas, then map [0, 65535] back onto the bounding box*/
+    outVertices.resize(vertexCount);
+    const float minValue[3] = {min.x, min.y, min.z};
+    const float scale[3] = {(max.x - min.x) / QUANTIZED_MAX, (max.y - min.y) / QUANTIZED_MAX, (max.z - min.z) / QUANTIZED_MAX};
+    for (unsigned int axis = 0; axis < 3; ++axis)
+    {
+        const uint8_t *plane = sections[0] + static_cast<size_t>(axis) * vertexCount * sizeof(uint16_t);
+        uint16_t quantized = 0;
+        for (uint32_t i = 0; i < vertexCount; ++i)
+        {
+            quantized = static_cast<uint16_t>(quantized + Get<uint16_t>(plane + i * sizeof(uint16_t)));
+            (&outVertices[i].x)[axis] = minValue[axis] + quantized * scale[axis];
+        }
+    }
+
+    return DecodeIndices(sections[1], static_cast<size_t>(sectionSizes[1]), vertexCount, outIndices) && outIndices.size() == indexCount;
+}
+
+bool QuantizedMesh::Read(const std::string &filename, std::vector<Triangle> &outMesh)
+{
+    std::vector<fPoint> vertices;
+    std::vector<unsigned int> indices;
+    if (!ReadIndexed(filename, vertices, indices))
+    {
+        return false;
+    }
+
+    outMesh.resize(indices.size() / 3);
+    for (size_t i = 0; i < outMesh.size(); i++)
+    {
+        outMesh[i] = Triangle{
+            vertices[indices[i * 3]],
+            vertices[indices[i * 3 + 1]],
+            vertices[indices[i * 3 + 2]]};
+    }
+    return true;
+}
+
+void QuantizedMesh::EncodeVertices(const std::vector<fPoint> &vertices, const fPoint &max, const fPoint &min, std::vector<uint8_t> &outBytes)
+{
+    outBytes.resize(vertices.size() * 3 * sizeof(uint16_t));
+
+    const float minValue[3] = {min.x, min.y, min.z};
+    const float extent[3] = {max.x - min.x, max.y - min.y, max.z - min.z};
+
+    /** One plane per axis, neighbouring vertices of a march are close so the deltas are small and repeat*/
+    for (unsigned int axis = 0; axis < 3; ++axis)
+    {
+        uint8_t *plane = outBytes.data() + axis * vertices.size() * sizeof(uint16_t);
+        uint16_t previous = 0;
+        for (size_t i = 0; i < vertices.size(); ++i)
+        {
+            const float value = (&vertices[i].x)[axis];
+            const float ratio = extent[axis] > 0 ? (value - minValue[axis]) / extent[axis] : 0.f;
+            const auto quantized = static_cast<uint16_t>(lroundf(std::min(std::max(ratio, 0.f), 1.f) * QUANTIZED_MAX));
+
+            const auto delta = static_cast<uint16_t>(quantized - previous);
+            memcpy(plane + i * sizeof(uint16_t), &delta, sizeof(uint16_t));
+            previous = quantized;
+        }
+    }
+}
+
+void QuantizedMesh::EncodeIndices(const std::vector<unsigned int> &indices, std::vector<uint8_t> &outBytes)
+{
+    outBytes.clear();
+    outBytes.reserve(indices.size() * 2);
+
+    /** The faces of a march reference the vertices made just before them, the deltas mostly fit in 1 or 2 bytes*/
+    int64_t previous = 0;
+    for (const auto index : indices)
+    {
+        const int64_t delta = static_cast<int64_t>(index) - previous;
+        uint64_t zigzag = (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63);
+        previous = index;
+
+        while (zigzag >= 0x80)
+        {
+            outBytes.emplace_back(static_cast<uint8_t>(zigzag | 0x80));
+            zigzag >>= 7;
+        }
+        outBytes.emplace_back(static_cast<uint8_t>(zigzag));
+    }
+}
+
+bool QuantizedMesh::DecodeIndices(const uint8_t *in, const size_t size, const unsigned int vertexCount, std::vector<unsigned int> &outIndices)
+{
+    outIndices.clear();
+
+    int64_t previous = 0;
+    size_t i = 0;
+    while (i < size)
+    {
+        uint64_t zigzag = 0;
+        unsigned int shift = 0;
+        for (;; shift += 7)
+        {
+            if (i == size || shift > 63)
+            {
+                return false;
+            }
+            const uint8_t byte = in[i++];
+            zigzag |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+            {
+                break;
+            }
+        }
+
+        const int64_t index = previous + static_cast<int64_t>((zigzag >> 1) ^ (~(zigzag & 1) + 1));
+        if (index < 0 || index >= vertexCount)
+        {
+            return false;
+        }
+        outIndices.emplace_back(static_cast<unsigned int>(index));
+        previous = index;
+    }
+    return true;
+}
+
+void QuantizedMesh::Compress(const uint8_t *src, const size_t size, std::vector<uint8_t> &out)
+{
+    out.clear();
+    out.reserve(size / 2 + 16);
+
+    /** Last position + 1 of every hashed 4 byte sequence, 0 => none*/
+    std::vector<uint32_t> table(static_cast<size_t>(1) << LZ_HASH_BITS, 0);
+
+    auto emitSequence = [&](const size_t literalBegin, const size_t literalEnd, const size_t offset, const size_t matchLength)
+    {
+        const size_t literalLength = literalEnd - literalBegin;
+        const size_t matchCode = matchLength ? matchLength - LZ_MIN_MATCH : 0;
+        out.emplace_back(static_cast<uint8_t>(std::min<size_t>(literalLength, 15) << 4 | std::min<size_t>(matchCode, 15)));
+        if (literalLength >= 15)
+        {
+            PutLength(out, literalLength - 15);
+        }
+        out.insert(out.end(), src + literalBegin, src + literalEnd);
+
+        if (matchLength)
+        {
+            out.emplace_back(static_cast<uint8_t>(offset));
+            out.emplace_back(static_cast<uint8_t>(offset >> 8));
+            if (matchCode >= 15)
+            {
+                PutLength(out, matchCode - 15);
+            }
+        }
+    };
+
+    size_t anchor = 0;
+    size_t i = 0;
+    while (size >= LZ_LAST_LITERALS && i + LZ_LAST_LITERALS <= size)
+    {
+        const auto sequence = Get<uint32_t>(src + i);
+        const uint32_t hash = (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+        const size_t candidate = table[hash];
+        table[hash] = static_cast<uint32_t>(i + 1);
+
+        if (candidate && i + 1 - candidate <= LZ_MAX_OFFSET && Get<uint32_t>(src + candidate - 1) == sequence)
+        {
+            const size_t match = candidate - 1;
+            size_t length = LZ_MIN_MATCH;
+            while (i + length < size && src[match + length] == src[i + length])
+            {
+                ++length;
+            }
+
+            emitSequence(anchor, i, i - match, length);
+            i += length;
+            anchor = i;
+            continue;
+        }
+        ++i;
+    }
+
+    emitSequence(anchor, size, 0, 0);
+}
+
+bool QuantizedMesh::Decompress(const uint8_t *src, const size_t srcSize, uint8_t *dst, const size_t dstSize)
+{
+    const uint8_t *in = src;
+    const uint8_t *const inEnd = src + srcSize;
+    uint8_t *out = dst;
+    uint8_t *const outEnd = dst + dstSize;
+
+    while (in < inEnd)
+    {
+        const uint8_t token = *in++;
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !GetLength(in, inEnd, literalLength))
+        {
+            return false;
+        }
+        if (literalLength > static_cast<size_t>(inEnd - in) || literalLength > static_cast<size_t>(outEnd - out))
+        {
+            return false;
+        }
+        memcpy(out, in, literalLength);
+        in += literalLength;
+        out += literalLength;
+
+        /** The last sequence ends with its literals*/
+        if (in == inEnd)
+        {
+            break;
+        }
+
+        if (inEnd - in < 2)
+        {
+            return false;
+        }
+        const size_t offset = in[0] | static_cast<size_t>(in[1]) << 8;
+        in += 2;
+        if (offset == 0 || offset > static_cast<size_t>(out - dst))
+        {
+            return false;
+        }
+
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !GetLength(in, inEnd, matchLength))
+        {
+            return false;
+        }
+        matchLength += LZ_MIN_MATCH;
+        if (matchLength > static_cast<size_t>(outEnd - out))
+        {
+            return false;
+        }
+
+        /** A match closer than its length repeats the bytes it is copying, copy those one at a time*/
+        const uint8_t *match = out - offset;
+        if (offset >= matchLength)
+        {
+            memcpy(out, match, matchLength);
+            out += matchLength;
+        }
+        else
+        {
+            for (size_t i = 0; i < matchLength; ++i)
+            {
+                *out++ = match[i];
+            }
+        }
+    }
+
+    return out == outEnd;
+}
@@ -0,0 +1,57 @@
+#ifndef __MARCHING_CUBE_QUANTIZED_MESH_H__
+#define __MARCHING_CUBE_QUANTIZED_MESH_H__
+
+#include "Types.h"
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Compact binary mesh container for archiving extracted surfaces:
+ *  vertices => 16 bit per coordinate within the bounding box of the mesh, stored as per axis planes of deltas
+ *  indices => zigzag deltas from the previous index as variable length integers
+ * Each of the two sections may be packed by the in-tree LZ block codec,
+ * a section is stored as is when packing does not make it smaller
+ *
+ * Layout (little endian):
+ *  "MCQM", version, vertex count, index count => 4 x 4 bytes
+ *  bounding box max then min => 6 floats
+ *  vertex section, index section => codec (4 bytes), raw size (8 bytes), stored size (8 bytes) each
+ *  stored vertex section, stored index section
+ */
+class QuantizedMesh
+{
+public:
+    /** filename, vertices, indices (3 per face), bounding box max, min, true => pack the sections, false if the file cannot be written*/
+    static bool Write(const std::string &, const std::vector<fPoint> &, const std::vector<unsigned int> &, const fPoint &, const fPoint &, const bool);
+
+    /** Map the file and decode it, false if the file cannot be read or is not a valid container*/
+    static bool ReadIndexed(const std::string &, std::vector<fPoint> &, std::vector<unsigned int> &);
+    static bool Read(const std::string &, std::vector<Triangle> &);
+
+private:
+    /** Codec of a section*/
+    enum SectionCodec
+    {
+        CODEC_RAW = 0,
+        CODEC_LZ = 1
+    };
+
+    /**
+     * LZ77 block codec in the spirit of LZ4 => a token (literal length << 4 | match length - 4),
+     * extra length bytes for the nibbles at 15, the literals then a 16 bit offset back to the match,
+     * the last sequence has literals only
+     */
+    static void Compress(const uint8_t *, const size_t, std::vector<uint8_t> &);
+
+    /** source, source size, destination, destination size => false unless the source decodes to exactly destination size bytes*/
+    static bool Decompress(const uint8_t *, const size_t, uint8_t *, const size_t);
+
+    static void EncodeVertices(const std::vector<fPoint> &, const fPoint &, const fPoint &, std::vector<uint8_t> &);
+    static void EncodeIndices(const std::vector<unsigned int> &, std::vector<uint8_t> &);
+    static bool DecodeIndices(const uint8_t *, const size_t, const unsigned int, std::vector<unsigned int> &);
+};
+
+#endif
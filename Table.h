@@ -36,6 +36,27 @@ namespace Table
         {3, 7}  // e11 => v3, v7
     };
 
+    /**
+     * Cube edge from e0 to e11 in canonical direction
+     * lower vertex, upper vertex, axis of the edge (0 => x, 1 => y, 2 => z)
+     * The lower vertex is the origin of the edge, so neighbouring cubes sharing an edge
+     * see the same origin and interpolate the same cross point
+     */
+    unsigned int cubeEdgeOrigins[12][3] = {
+        {0, 1, 0}, // e0 => v0 -> v1 along x
+        {1, 2, 2}, // e1 => v1 -> v2 along z
+        {3, 2, 0}, // e2 => v3 -> v2 along x
+        {0, 3, 2}, // e3 => v0 -> v3 along z
+        {4, 5, 0}, // e4 => v4 -> v5 along x
+        {5, 6, 2}, // e5 => v5 -> v6 along z
+        {7, 6, 0}, // e6 => v7 -> v6 along x
+        {4, 7, 2}, // e7 => v4 -> v7 along z
+        {0, 4, 1}, // e8 => v0 -> v4 along y
+        {1, 5, 1}, // e9 => v1 -> v5 along y
+        {2, 6, 1}, // e10 => v2 -> v6 along y
+        {3, 7, 1}  // e11 => v3 -> v7 along y
+    };
+
     unsigned int edgeTable[256] = {
         0x0, 0x109, 0x203, 0x30a, 0x406, 0x50f, 0x605, 0x70c,
         0x80c, 0x905, 0xa0f, 0xb06, 0xc0a, 0xd03, 0xe09, 0xf00,
@@ -3,11 +3,28 @@
 
 #define DEFAULT_ISOSURFACE 100
 
+/** Type of the points of a volume, 0 is 8 bit so a dimension made without a type is an 8 bit volume*/
+#define VOXEL_UINT8 0
+#define VOXEL_UINT16 1
+#define VOXEL_INT16 2
+#define VOXEL_FLOAT32 3
+
+/** How a DICOM build which is not full depth windows 16 bit samples to 8 bit, 0 stretches every slice by its own min/max*/
+#define WINDOW_SLICE_MINMAX 0
+/** By the min/max of the whole volume, a sample has the same 8 bit value in every slice*/
+#define WINDOW_VOLUME_MINMAX 1
+/** By the Window Center/Width of every slice after its Rescale Slope/Intercept*/
+#define WINDOW_DICOM 2
+/** By a center and a width in Hounsfield units after the Rescale Slope/Intercept of every slice*/
+#define WINDOW_HOUNSFIELD 3
+
 typedef struct _dimension
 {
     unsigned int width;
     unsigned int height;
     unsigned int depth;
+    /** VOXEL_* of the points, little endian*/
+    unsigned int voxelType;
 } Dimension;
 
 typedef struct _upoint
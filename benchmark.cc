@@ -0,0 +1,927 @@
+#include "MarchingCube.h"
+#include "QuantizedMesh.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <new>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/** Every heap allocation made by the process goes through here, so a march can report how often it hit the allocator*/
+static std::atomic<unsigned long long> allocationCount{0};
+
+void *operator new(size_t size)
+{
+    ++allocationCount;
+    if (void *ptr = malloc(size ? size : 1))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+/**
+ * Synthetic CT-like phantom: a dense ball with a hollow core inside an empty box,
+ * so most cubes are empty and a thin shell is cut by the usual isovalues
+ */
+static void MakePhantom(const Dimension &dimension, std::vector<uint8_t> &outBuffer)
+{
+    outBuffer.resize(static_cast<size_t>(dimension.width) * dimension.height * dimension.depth);
+
+    const float cx = dimension.width / 2.f, cy = dimension.height / 2.f, cz = dimension.depth / 2.f;
+    const float radius = std::min(std::min(cx, cy), cz);
+
+    size_t index = 0;
+    for (unsigned int z = 0; z < dimension.depth; ++z)
+    {
+        for (unsigned int y = 0; y < dimension.height; ++y)
+        {
+            for (unsigned int x = 0; x < dimension.width; ++x)
+            {
+                const float dx = x - cx, dy = y - cy, dz = z - cz;
+                const float r = sqrtf(dx * dx + dy * dy + dz * dz) / radius;
+                float value = 0;
+                if (r < 0.9f)
+                {
+                    value = r < 0.4f ? 60.f : 220.f - 80.f * r;
+                }
+                /** a little deterministic texture so the shell is not perfectly smooth*/
+                value += static_cast<float>((x * 7 + y * 13 + z * 17) % 11);
+                outBuffer[index++] = static_cast<uint8_t>(std::min(value, 255.f));
+            }
+        }
+    }
+}
+
+using Clock = std::chrono::steady_clock;
+
+static double Elapsed(const Clock::time_point &start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+/** The tables are defined by MarchingCube.cc, Table.h can only be included by one translation unit*/
+namespace Table
+{
+    extern unsigned int cubeVertices[8][3];
+    extern unsigned int cubeEdges[12][2];
+    extern unsigned int edgeTable[256];
+    extern int triTable[256][16];
+}
+
+/**
+ * The cell kernel as it was: x outermost and z innermost, the 8 corner values and the 12 cross points
+ * in two heap vectors per cube, every cube interpolated on its own into a triangle soup
+ */
+static void MarchLegacy(const Dimension &dimension, const std::vector<uint8_t> &volume, const unsigned int iso, std::vector<Triangle> &outMesh)
+{
+    outMesh.clear();
+    auto pointData = [&](const unsigned int x, const unsigned int y, const unsigned int z)
+    {
+        return static_cast<unsigned int>(volume[(static_cast<size_t>(z) * dimension.height + y) * dimension.width + x]);
+    };
+
+    for (unsigned int x = 0; x < dimension.width - 1; ++x)
+    {
+        for (unsigned int y = 0; y < dimension.height - 1; ++y)
+        {
+            for (unsigned int z = 0; z < dimension.depth - 1; ++z)
+            {
+                std::vector<unsigned int> cubeVerticesValue(8);
+                unsigned int cubeIndex = 0;
+                for (int i = 0; i < 8; ++i)
+                {
+                    cubeVerticesValue[i] = pointData(x + Table::cubeVertices[i][0], y + Table::cubeVertices[i][1], z + Table::cubeVertices[i][2]);
+                    if (cubeVerticesValue[i] < iso)
+                    {
+                        cubeIndex |= 1 << i;
+                    }
+                }
+
+                const unsigned int edges = Table::edgeTable[cubeIndex];
+                std::vector<fPoint> edgeCrossVertices(12);
+                for (int i = 0; i < 12; ++i)
+                {
+                    if (edges & (1 << i))
+                    {
+                        const unsigned int *p1 = Table::cubeVertices[Table::cubeEdges[i][0]];
+                        const unsigned int *p2 = Table::cubeVertices[Table::cubeEdges[i][1]];
+                        const unsigned int p1Val = cubeVerticesValue[Table::cubeEdges[i][0]];
+                        const unsigned int p2Val = cubeVerticesValue[Table::cubeEdges[i][1]];
+                        const float ratio = p1Val == p2Val ? 0.5f : (static_cast<float>(iso) - p1Val) / (static_cast<float>(p2Val) - p1Val);
+                        edgeCrossVertices[i] = fPoint{
+                            x + p1[0] + ratio * (static_cast<float>(p2[0]) - p1[0]),
+                            y + p1[1] + ratio * (static_cast<float>(p2[1]) - p1[1]),
+                            z + p1[2] + ratio * (static_cast<float>(p2[2]) - p1[2])};
+                    }
+                }
+
+                for (int i = 0; Table::triTable[cubeIndex][i] != -1; i += 3)
+                {
+                    outMesh.emplace_back(Triangle{
+                        edgeCrossVertices[Table::triTable[cubeIndex][i]],
+                        edgeCrossVertices[Table::triTable[cubeIndex][i + 1]],
+                        edgeCrossVertices[Table::triTable[cubeIndex][i + 2]]});
+                }
+            }
+        }
+    }
+}
+
+/** Time one march of the legacy kernel and of the current one, and count the allocations each made*/
+static void BenchKernel(const Dimension &dimension, const std::vector<uint8_t> &volume)
+{
+    MarchingCube mc(volume, dimension);
+    const double cells = static_cast<double>(dimension.width - 1) * (dimension.height - 1) * (dimension.depth - 1);
+
+    printf("%-10s %-8s %12s %12s %12s %14s %14s %12s %12s\n", "isovalue", "kernel", "faces", "vertices", "time(ms)", "Mcells/s", "allocations", "soup(MB)", "indexed(MB)");
+    for (unsigned int iso : {30u, 100u, 180u})
+    {
+        std::vector<Triangle> legacyMesh;
+        auto allocBefore = allocationCount.load();
+        auto start = Clock::now();
+        MarchLegacy(dimension, volume, iso, legacyMesh);
+        double ms = Elapsed(start);
+        auto allocations = allocationCount.load() - allocBefore;
+        printf("%-10u %-8s %12zu %12zu %12.1f %14.1f %14llu %12.1f %12s\n", iso, "legacy", legacyMesh.size(), legacyMesh.size() * 3, ms, cells / ms / 1000.0, allocations,
+               legacyMesh.size() * sizeof(Triangle) / 1048576.0, "-");
+        legacyMesh = std::vector<Triangle>();
+
+        std::vector<fPoint> vertices;
+        std::vector<unsigned int> indices;
+        allocBefore = allocationCount.load();
+        start = Clock::now();
+        mc.March(iso);
+        ms = Elapsed(start);
+        allocations = allocationCount.load() - allocBefore;
+        mc.GetCurrentIndexedMesh(vertices, indices);
+
+        const size_t faces = indices.size() / 3;
+        printf("%-10u %-8s %12zu %12zu %12.1f %14.1f %14llu %12.1f %12.1f\n", iso, "current", faces, vertices.size(), ms, cells / ms / 1000.0, allocations,
+               faces * sizeof(Triangle) / 1048576.0,
+               (vertices.size() * sizeof(fPoint) + indices.size() * sizeof(unsigned int)) / 1048576.0);
+    }
+}
+
+/** Classify every cube in the order March used to walk them: x outermost, z innermost (every step jumps a whole slice)*/
+static unsigned long long ClassifyStrided(const Dimension &dimension, const std::vector<uint8_t> &volume, const unsigned int iso)
+{
+    const size_t row = dimension.width, slice = static_cast<size_t>(dimension.width) * dimension.height;
+    unsigned long long active = 0;
+
+    for (unsigned int x = 0; x < dimension.width - 1; ++x)
+    {
+        for (unsigned int y = 0; y < dimension.height - 1; ++y)
+        {
+            for (unsigned int z = 0; z < dimension.depth - 1; ++z)
+            {
+                const uint8_t *p = volume.data() + z * slice + y * row + x;
+                const unsigned int below =
+                    (p[0] < iso) + (p[1] < iso) + (p[slice] < iso) + (p[slice + 1] < iso) +
+                    (p[row] < iso) + (p[row + 1] < iso) + (p[row + slice] < iso) + (p[row + slice + 1] < iso);
+                active += below != 0 && below != 8;
+            }
+        }
+    }
+    return active;
+}
+
+/** Classify every cube in memory order, z => y => x, reusing the four x + 1 corners as the next cube's x corners*/
+static unsigned long long ClassifySequential(const Dimension &dimension, const std::vector<uint8_t> &volume, const unsigned int iso)
+{
+    const size_t row = dimension.width, slice = static_cast<size_t>(dimension.width) * dimension.height;
+    unsigned long long active = 0;
+
+    for (unsigned int z = 0; z < dimension.depth - 1; ++z)
+    {
+        for (unsigned int y = 0; y < dimension.height - 1; ++y)
+        {
+            const uint8_t *row00 = volume.data() + z * slice + y * row;
+            const uint8_t *row01 = row00 + slice, *row10 = row00 + row, *row11 = row00 + slice + row;
+            unsigned int side = (row00[0] < iso) + (row01[0] < iso) + (row10[0] < iso) + (row11[0] < iso);
+
+            for (unsigned int x = 0; x < dimension.width - 1; ++x)
+            {
+                const unsigned int nextSide = (row00[x + 1] < iso) + (row01[x + 1] < iso) + (row10[x + 1] < iso) + (row11[x + 1] < iso);
+                const unsigned int below = side + nextSide;
+                active += below != 0 && below != 8;
+                side = nextSide;
+            }
+        }
+    }
+    return active;
+}
+
+/**
+ * Traversal order alone (classification only) and the full March.
+ * Run under `perf stat -e cache-misses,cache-references ./benchmark.exe traversal 512` for the miss counts.
+ */
+static void BenchTraversal(const Dimension &dimension, const std::vector<uint8_t> &volume)
+{
+    const unsigned int iso = 100;
+
+    auto start = Clock::now();
+    const auto stridedActive = ClassifyStrided(dimension, volume, iso);
+    const double stridedMs = Elapsed(start);
+
+    start = Clock::now();
+    const auto sequentialActive = ClassifySequential(dimension, volume, iso);
+    const double sequentialMs = Elapsed(start);
+
+    printf("%-28s %12s %14s\n", "traversal", "time(ms)", "active cubes");
+    printf("%-28s %12.1f %14llu\n", "x/y/z (strided, old March)", stridedMs, stridedActive);
+    printf("%-28s %12.1f %14llu\n", "z/y/x (memory order)", sequentialMs, sequentialActive);
+
+    MarchingCube mc(volume, dimension);
+    start = Clock::now();
+    mc.March(iso);
+    printf("%-28s %12.1f\n", "March (z/y/x)", Elapsed(start));
+}
+
+/** Brick tree build cost and the March time with and without skipping inactive bricks*/
+static void BenchBricks(const Dimension &dimension, const std::vector<uint8_t> &volume)
+{
+    /** The constructor copies the buffer too, take the copy out of the build time*/
+    auto start = Clock::now();
+    std::vector<uint8_t> copy(volume);
+    const double copyMs = Elapsed(start);
+
+    start = Clock::now();
+    MarchingCube mc(volume, dimension);
+    const double constructMs = Elapsed(start);
+
+    printf("brick tree build: %.1f ms, memory: %zu bytes (%.3f%% of the volume)\n",
+           constructMs - copyMs, mc.GetBrickTreeMemory(), 100.0 * mc.GetBrickTreeMemory() / volume.size());
+
+    printf("%-10s %14s %14s %10s\n", "isovalue", "full(ms)", "skipping(ms)", "speedup");
+    for (unsigned int iso : {30u, 65u, 100u, 150u, 180u, 230u})
+    {
+        mc.SetBrickSkipping(false);
+        start = Clock::now();
+        mc.March(iso);
+        const double fullMs = Elapsed(start);
+
+        mc.SetBrickSkipping(true);
+        start = Clock::now();
+        mc.March(iso);
+        const double skipMs = Elapsed(start);
+
+        printf("%-10u %14.1f %14.1f %9.1fx\n", iso, fullMs, skipMs, fullMs / skipMs);
+    }
+}
+
+/** Batch of isovalues against one volume, brick tree descent against the span space index at several memory budgets*/
+static void BenchSpanSpace(const Dimension &dimension, const std::vector<uint8_t> &volume)
+{
+    MarchingCube mc(volume, dimension);
+
+    auto marchAll = [&mc]()
+    {
+        const auto start = Clock::now();
+        for (unsigned int iso = 20; iso <= 250; iso += 5)
+        {
+            mc.March(iso);
+        }
+        return Elapsed(start);
+    };
+
+    printf("%-16s %12s %14s %16s\n", "budget", "build(ms)", "memory(bytes)", "47 isovalues(ms)");
+    printf("%-16s %12s %14zu %16.1f\n", "brick tree", "-", mc.GetBrickTreeMemory(), marchAll());
+
+    for (size_t budget : {static_cast<size_t>(64) << 20, static_cast<size_t>(64) << 10, static_cast<size_t>(8) << 10})
+    {
+        const auto start = Clock::now();
+        const bool isBuilt = mc.BuildSpanSpaceIndex(budget);
+        const double buildMs = Elapsed(start);
+
+        if (!isBuilt)
+        {
+            printf("%-16zu %12s\n", budget, "no fit");
+            continue;
+        }
+        printf("%-16zu %12.2f %14zu %16.1f\n", budget, buildMs, mc.GetSpanSpaceIndexMemory(), marchAll());
+    }
+}
+
+/** The same file marched from the mapping and streamed two slices at a time*/
+static void BenchStream(const Dimension &dimension, const std::vector<uint8_t> &volume)
+{
+    const std::string filename = "benchmark_stream.raw";
+    FILE *rawFile = fopen(filename.c_str(), "wb");
+    if (!rawFile || fwrite(volume.data(), 1, volume.size(), rawFile) != volume.size())
+    {
+        printf("cannot write %s\n", filename.c_str());
+        if (rawFile)
+        {
+            fclose(rawFile);
+        }
+        return;
+    }
+    fclose(rawFile);
+
+    printf("streaming window: %zu bytes (%.3f%% of the volume)\n", volume.size() / dimension.depth * 2, 200.0 / dimension.depth);
+    printf("%-10s %14s %14s %12s %12s\n", "isovalue", "mapped(ms)", "streamed(ms)", "faces", "identical");
+    for (unsigned int iso : {30u, 100u, 180u})
+    {
+        std::vector<Triangle> mappedMesh, streamedMesh;
+
+        auto start = Clock::now();
+        {
+            MarchingCube mc(filename, dimension);
+            mc.March(iso);
+            mc.GetCurrentMesh(mappedMesh);
+        }
+        const double mappedMs = Elapsed(start);
+
+        start = Clock::now();
+        {
+            MarchingCube mc(filename, dimension, true);
+            mc.March(iso);
+            mc.GetCurrentMesh(streamedMesh);
+        }
+        const double streamedMs = Elapsed(start);
+
+        const bool isIdentical = mappedMesh.size() == streamedMesh.size() &&
+                                 memcmp(mappedMesh.data(), streamedMesh.data(), mappedMesh.size() * sizeof(Triangle)) == 0;
+        printf("%-10u %14.1f %14.1f %12zu %12s\n", iso, mappedMs, streamedMs, streamedMesh.size(), isIdentical ? "yes" : "no");
+    }
+
+    remove(filename.c_str());
+}
+
+/** Counts the triangles pushed by a march and keeps none of them*/
+class CountingSink : public MeshSink
+{
+public:
+    void Consume(const Triangle *, const size_t count) override
+    {
+        triangles += count;
+        ++batches;
+    }
+
+    size_t triangles = 0;
+    size_t batches = 0;
+};
+
+/** March then GetCurrentMesh against marching into a sink which drops every batch*/
+static void BenchSink(const Dimension &dimension, const std::vector<uint8_t> &volume)
+{
+    MarchingCube mc(volume, dimension);
+
+    printf("%-10s %14s %14s %12s %12s\n", "isovalue", "mesh(ms)", "sink(ms)", "faces", "batches");
+    for (unsigned int iso : {30u, 100u, 180u})
+    {
+        std::vector<Triangle> mesh;
+        auto start = Clock::now();
+        mc.March(iso);
+        mc.GetCurrentMesh(mesh);
+        const double meshMs = Elapsed(start);
+        mesh = std::vector<Triangle>();
+
+        CountingSink sink;
+        start = Clock::now();
+        mc.March(iso, sink);
+        const double sinkMs = Elapsed(start);
+
+        printf("%-10u %14.1f %14.1f %12zu %12zu\n", iso, meshMs, sinkMs, sink.triangles, sink.batches);
+    }
+}
+
+/** The OBJ writer as it was: triangle soup, std::to_string per number, one ofstream insertion per line*/
+static void WriteLegacyObj(const std::string &objFilename, const std::vector<Triangle> &mesh)
+{
+    std::ofstream outFile(objFilename);
+    outFile << "# OBJ file generated by MarchingCube Algorithm\n# Face Count = " + std::to_string(mesh.size()) + "\n";
+
+    for (const auto &t : mesh)
+    {
+        for (const auto &v : {t.v0, t.v1, t.v2})
+        {
+            outFile << "v " + std::to_string(v.x) + " " + std::to_string(v.y) + " " + std::to_string(v.z) + "\n";
+        }
+    }
+    for (size_t i = 0; i < mesh.size(); i++)
+    {
+        outFile << "f " + std::to_string(i * 3 + 1) + " " + std::to_string(i * 3 + 2) + " " + std::to_string(i * 3 + 3) + "\n";
+    }
+}
+
+/** Time and size of the legacy soup writer against the buffered indexed OBJ writer and the binary exporters*/
+static void BenchWriters(const Dimension &dimension, const std::vector<uint8_t> &volume)
+{
+    MarchingCube mc(volume, dimension);
+    mc.March(180);
+
+    std::vector<Triangle> mesh;
+    mc.GetCurrentMesh(mesh);
+    printf("faces: %zu\n", mesh.size());
+
+    auto report = [](const char *name, const std::string &filename, const double ms)
+    {
+        printf("%-32s %12.1f %12.1f\n", name, ms, std::filesystem::file_size(filename) / 1048576.0);
+        remove(filename.c_str());
+    };
+
+    printf("%-32s %12s %12s\n", "writer", "time(ms)", "size(MB)");
+
+    auto start = Clock::now();
+    WriteLegacyObj("benchmark_mesh.obj", mesh);
+    report("OBJ legacy (soup, to_string)", "benchmark_mesh.obj", Elapsed(start));
+
+    start = Clock::now();
+    mc.WriteCurrentMeshToObj("benchmark_mesh.obj", 1);
+    report("OBJ indexed, to_chars, 1 thread", "benchmark_mesh.obj", Elapsed(start));
+
+    start = Clock::now();
+    mc.WriteCurrentMeshToObj("benchmark_mesh.obj", 0);
+    report("OBJ indexed, to_chars, all", "benchmark_mesh.obj", Elapsed(start));
+
+    start = Clock::now();
+    mc.WriteCurrentMeshToPly("benchmark_mesh.ply", false);
+    report("PLY binary", "benchmark_mesh.ply", Elapsed(start));
+
+    start = Clock::now();
+    mc.WriteCurrentMeshToPly("benchmark_mesh.ply", true);
+    report("PLY binary, vertex normals", "benchmark_mesh.ply", Elapsed(start));
+
+    start = Clock::now();
+    mc.WriteCurrentMeshToStl("benchmark_mesh.stl");
+    report("STL binary", "benchmark_mesh.stl", Elapsed(start));
+}
+
+/** Minimal reader of the OBJ files WriteCurrentMeshToObj makes, v and f lines only*/
+static bool ReadObj(const std::string &objFilename, std::vector<Triangle> &outMesh)
+{
+    FILE *inFile = fopen(objFilename.c_str(), "rb");
+    if (!inFile)
+    {
+        return false;
+    }
+    std::vector<char> text(std::filesystem::file_size(objFilename) + 1, 0);
+    const size_t size = fread(text.data(), 1, text.size() - 1, inFile);
+    fclose(inFile);
+
+    std::vector<fPoint> vertices;
+    outMesh.clear();
+    for (char *p = text.data(), *end = text.data() + size; p < end;)
+    {
+        if (p[0] == 'v' && p[1] == ' ')
+        {
+            fPoint v;
+            v.x = strtof(p + 2, &p);
+            v.y = strtof(p, &p);
+            v.z = strtof(p, &p);
+            vertices.emplace_back(v);
+        }
+        else if (p[0] == 'f' && p[1] == ' ')
+        {
+            const unsigned long i0 = strtoul(p + 2, &p, 10), i1 = strtoul(p, &p, 10), i2 = strtoul(p, &p, 10);
+            outMesh.emplace_back(Triangle{vertices[i0 - 1], vertices[i1 - 1], vertices[i2 - 1]});
+        }
+        p = static_cast<char *>(memchr(p, '\n', end - p));
+        p = p ? p + 1 : end;
+    }
+    return true;
+}
+
+/** Size and decode throughput of the quantized container against OBJ and binary PLY*/
+static void BenchQuantized(const Dimension &dimension, const std::vector<uint8_t> &volume)
+{
+    MarchingCube mc(volume, dimension);
+    mc.March(180);
+
+    std::vector<Triangle> mesh;
+    mc.GetCurrentMesh(mesh);
+    printf("faces: %zu, triangle soup in memory: %.1f MB\n", mesh.size(), mesh.size() * sizeof(Triangle) / 1048576.0);
+
+    printf("%-24s %12s %12s %12s %14s\n", "format", "write(ms)", "size(MB)", "read(ms)", "Mfaces/s read");
+    auto report = [&mesh](const char *name, const std::string &filename, const double writeMs, const std::function<bool(std::vector<Triangle> &)> &read)
+    {
+        std::vector<Triangle> decoded;
+        const auto start = Clock::now();
+        const bool isRead = read(decoded);
+        const double readMs = Elapsed(start);
+        printf("%-24s %12.1f %12.1f %12.1f %14.1f%s\n", name, writeMs, std::filesystem::file_size(filename) / 1048576.0, readMs,
+               decoded.size() / readMs / 1000.0, isRead && decoded.size() == mesh.size() ? "" : "  (read failed)");
+        remove(filename.c_str());
+    };
+
+    auto start = Clock::now();
+    mc.WriteCurrentMeshToObj("benchmark_mesh.obj", 0);
+    report("OBJ", "benchmark_mesh.obj", Elapsed(start), [](std::vector<Triangle> &out)
+           { return ReadObj("benchmark_mesh.obj", out); });
+
+    for (const bool isCompressed : {false, true})
+    {
+        start = Clock::now();
+        mc.WriteCurrentMeshToQuantized("benchmark_mesh.mcq", isCompressed);
+        report(isCompressed ? "quantized, LZ packed" : "quantized", "benchmark_mesh.mcq", Elapsed(start), [](std::vector<Triangle> &out)
+               { return QuantizedMesh::Read("benchmark_mesh.mcq", out); });
+    }
+}
+
+/** N separate marches against one MarchMulti over the same isovalues, mapped and streamed*/
+static void BenchMulti(const Dimension &dimension, const std::vector<uint8_t> &volume)
+{
+    const std::string filename = "benchmark_multi.raw";
+    FILE *rawFile = fopen(filename.c_str(), "wb");
+    if (!rawFile || fwrite(volume.data(), 1, volume.size(), rawFile) != volume.size())
+    {
+        printf("cannot write %s\n", filename.c_str());
+        if (rawFile)
+        {
+            fclose(rawFile);
+        }
+        return;
+    }
+    fclose(rawFile);
+
+    const std::vector<unsigned int> isoSurfaces{30u, 60u, 100u, 140u, 180u, 220u};
+
+    printf("%-10s %8s %14s %14s %12s\n", "source", "threads", "separate(ms)", "multi(ms)", "identical");
+    for (const bool isStreaming : {false, true})
+    {
+        MarchingCube mc(filename, dimension, isStreaming);
+
+        /** Streaming instances march serially whatever the thread count*/
+        for (const unsigned int threadCount : {1u, 0u})
+        {
+            if (isStreaming && threadCount != 1)
+            {
+                continue;
+            }
+
+            std::vector<std::vector<Triangle>> separateMeshes(isoSurfaces.size());
+            auto start = Clock::now();
+            for (size_t i = 0; i < isoSurfaces.size(); ++i)
+            {
+                mc.March(isoSurfaces[i], threadCount);
+                mc.GetCurrentMesh(separateMeshes[i]);
+            }
+            const double separateMs = Elapsed(start);
+
+            start = Clock::now();
+            mc.MarchMulti(isoSurfaces, threadCount);
+            const double multiMs = Elapsed(start);
+
+            bool isIdentical = true;
+            for (size_t i = 0; i < isoSurfaces.size(); ++i)
+            {
+                std::vector<Triangle> levelMesh;
+                mc.GetLevelMesh(static_cast<unsigned int>(i), levelMesh);
+                isIdentical = isIdentical && levelMesh.size() == separateMeshes[i].size() &&
+                              memcmp(levelMesh.data(), separateMeshes[i].data(), levelMesh.size() * sizeof(Triangle)) == 0;
+            }
+
+            printf("%-10s %8s %14.1f %14.1f %12s\n", isStreaming ? "streamed" : "mapped", threadCount ? "1" : "all", separateMs, multiMs, isIdentical ? "yes" : "no");
+        }
+    }
+
+    remove(filename.c_str());
+}
+
+/** Brush strokes patched into a marched volume against rebuilding the instance and marching it again*/
+static void BenchPatch(const Dimension &dimension, const std::vector<uint8_t> &volume)
+{
+    MarchingCube mc(volume, dimension);
+    mc.March(100);
+
+    std::vector<uint8_t> edited = volume;
+    std::vector<uint8_t> brush;
+    auto stroke = [&](const unsigned int i, const unsigned int brushSize, uPoint &outFirst, Dimension &outSize)
+    {
+        /** A solid cube painted on the shell of the phantom*/
+        outSize = Dimension{brushSize, brushSize, brushSize, VOXEL_UINT8};
+        outFirst = uPoint{dimension.width / 2 - brushSize / 2 + i % 7, dimension.height / 8 + i % 5, dimension.depth / 2 - brushSize / 2};
+        brush.assign(static_cast<size_t>(brushSize) * brushSize * brushSize, static_cast<uint8_t>(150 + i));
+
+        for (unsigned int z = 0; z < brushSize; ++z)
+        {
+            for (unsigned int y = 0; y < brushSize; ++y)
+            {
+                memcpy(edited.data() + (static_cast<size_t>(outFirst.z + z) * dimension.height + outFirst.y + y) * dimension.width + outFirst.x,
+                       brush.data() + (static_cast<size_t>(z) * brushSize + y) * brushSize, brushSize);
+            }
+        }
+    };
+
+    uPoint first;
+    Dimension size;
+    stroke(0, 8, first, size);
+    auto start = Clock::now();
+    mc.PatchVolume(first, size, brush.data());
+    printf("first patch (splits the mesh into chunks): %.1f ms\n", Elapsed(start));
+
+    printf("%-8s %12s %14s %12s\n", "brush", "patch(ms)", "rebuild(ms)", "faces");
+    for (const unsigned int brushSize : {4u, 8u, 16u})
+    {
+        const unsigned int strokes = 10;
+        start = Clock::now();
+        for (unsigned int i = 0; i < strokes; ++i)
+        {
+            stroke(i, brushSize, first, size);
+            mc.PatchVolume(first, size, brush.data());
+        }
+        const double patchMs = Elapsed(start) / strokes;
+
+        start = Clock::now();
+        MarchingCube rebuilt(edited, dimension);
+        rebuilt.March(100);
+        const double rebuildMs = Elapsed(start);
+
+        std::vector<Triangle> mesh;
+        mc.GetCurrentMesh(mesh);
+        printf("%-8u %12.2f %14.1f %12zu\n", brushSize, patchMs, rebuildMs, mesh.size());
+    }
+}
+
+/** One flat mesh against mesh chunks, the allocations count the growth of the mesh storage*/
+static void BenchChunks(const Dimension &dimension, const std::vector<uint8_t> &volume)
+{
+    MarchingCube mc(volume, dimension);
+
+    printf("%-22s %8s %12s %14s %12s\n", "march", "threads", "time(ms)", "allocations", "chunks");
+    for (const unsigned int threadCount : {1u, 0u})
+    {
+        auto allocations = allocationCount.load();
+        auto start = Clock::now();
+        mc.March(100, threadCount);
+        printf("%-22s %8s %12.1f %14llu %12s\n", "flat", threadCount ? "1" : "all", Elapsed(start), allocationCount.load() - allocations, "-");
+
+        allocations = allocationCount.load();
+        start = Clock::now();
+        mc.MarchChunked(100, threadCount);
+        const double chunkedMs = Elapsed(start);
+        const auto chunkedAllocations = allocationCount.load() - allocations;
+
+        unsigned int nonEmpty = 0;
+        for (unsigned int i = 0; i < mc.GetChunkCount(); ++i)
+        {
+            nonEmpty += !mc.IsChunkEmpty(i);
+        }
+        printf("%-22s %8s %12.1f %14llu %5u / %-5u\n", "chunked", threadCount ? "1" : "all", chunkedMs, chunkedAllocations, nonEmpty, mc.GetChunkCount());
+
+        /** The flat mesh is only assembled by the first getter*/
+        start = Clock::now();
+        fPoint max, min;
+        mc.GetCurrentBoundingBox(max, min);
+        printf("%-22s %8s %12.1f\n", "  + assemble flat", "", Elapsed(start));
+    }
+}
+
+/** Normalization throughput in vertices per second, the per vertex divisions of the previous code as the baseline*/
+static void BenchNormalize(const Dimension &dimension, const std::vector<uint8_t> &volume)
+{
+    MarchingCube mc(volume, dimension);
+    mc.March(100);
+
+    std::vector<fPoint> vertices;
+    std::vector<unsigned int> indices;
+    mc.GetCurrentIndexedMesh(vertices, indices);
+    fPoint max, min;
+    mc.GetCurrentBoundingBox(max, min);
+
+    const unsigned int rounds = 20;
+    auto report = [&](const char *name, const double ms)
+    {
+        printf("%-28s %12.2f %16.1f\n", name, ms / rounds, vertices.size() * rounds / (ms / 1000.0) / 1e6);
+    };
+
+    printf("%zu vertices\n", vertices.size());
+    printf("%-28s %12s %16s\n", "normalization", "time(ms)", "Mvertices/s");
+
+    /** Both copy variants hand out the indices as well*/
+    std::vector<fPoint> out(vertices.size());
+    std::vector<unsigned int> outIndices;
+    auto start = Clock::now();
+    for (unsigned int r = 0; r < rounds; ++r)
+    {
+        outIndices = indices;
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            out[i] = fPoint{
+                2 * (vertices[i].x - min.x) / (max.x - min.x) - 1,
+                2 * (vertices[i].y - min.y) / (max.y - min.y) - 1,
+                2 * (vertices[i].z - min.z) / (max.z - min.z) - 1};
+        }
+    }
+    report("per vertex divisions, copy", Elapsed(start));
+
+    for (const unsigned int threadCount : {1u, 0u})
+    {
+        start = Clock::now();
+        for (unsigned int r = 0; r < rounds; ++r)
+        {
+            mc.GetCurrentIndexedMeshNormalized(out, outIndices, threadCount);
+        }
+        report(threadCount ? "SIMD copy, 1 thread" : "SIMD copy, all", Elapsed(start));
+    }
+
+    /** Each round normalizes an already normalized mesh, the work is the same*/
+    start = Clock::now();
+    for (unsigned int r = 0; r < rounds; ++r)
+    {
+        mc.NormalizeCurrentMesh(0);
+    }
+    report("SIMD in place, all", Elapsed(start));
+}
+
+/** Normals made with the mesh against a second pass of flat face normals over the triangles*/
+static void BenchNormals(const Dimension &dimension, const std::vector<uint8_t> &volume)
+{
+    MarchingCube mc(volume, dimension);
+    std::vector<Triangle> mesh;
+    std::vector<fPoint> normals;
+
+    printf("%-36s %12s %12s\n", "normals", "time(ms)", "normals");
+
+    auto start = Clock::now();
+    mc.March(100);
+    printf("%-36s %12.1f %12s\n", "march, no normals", Elapsed(start), "-");
+
+    start = Clock::now();
+    mc.March(100);
+    mc.GetCurrentMesh(mesh);
+    MarchingCube::GetMeshNormal(mesh, normals);
+    printf("%-36s %12.1f %12zu\n", "march + face normal pass", Elapsed(start), normals.size());
+
+    mc.SetGradientNormals(true);
+    for (const unsigned int threadCount : {1u, 0u})
+    {
+        start = Clock::now();
+        mc.March(100, threadCount);
+        const double marchMs = Elapsed(start);
+        mc.GetCurrentVertexNormals(normals, false);
+        printf("%-36s %12.1f %12zu\n", threadCount ? "march with gradient normals, 1" : "march with gradient normals, all", marchMs, normals.size());
+    }
+
+    /** What the drawler is given, 3 normals per triangle*/
+    start = Clock::now();
+    mc.GetCurrentMesh(mesh);
+    mc.GetCurrentMeshVertexNormals(normals, false);
+    printf("%-36s %12.1f %12zu\n", "  + expand per triangle", Elapsed(start), normals.size());
+}
+
+/** Face normals of the marched triangles, the copies and per face division of the previous C API path as the baseline*/
+static void BenchFaceNormals(const Dimension &dimension, const std::vector<uint8_t> &volume)
+{
+    MarchingCube mc(volume, dimension);
+    mc.March(100);
+    std::vector<Triangle> mesh;
+    mc.GetCurrentMesh(mesh);
+
+    const unsigned int rounds = 10;
+    auto report = [&](const char *name, const double ms)
+    {
+        printf("%-30s %12.2f %14.1f\n", name, ms / rounds, mesh.size() * rounds / (ms / 1000.0) / 1e6);
+    };
+
+    printf("%zu faces\n", mesh.size());
+    printf("%-30s %12s %14s\n", "face normals", "time(ms)", "Mfaces/s");
+
+    fPoint *normals = nullptr;
+    auto start = Clock::now();
+    for (unsigned int r = 0; r < rounds; ++r)
+    {
+        std::vector<Triangle> copied(mesh.size());
+        memcpy(copied.data(), mesh.data(), mesh.size() * sizeof(Triangle));
+
+        std::vector<fPoint> norms;
+        for (const auto &m : copied)
+        {
+            const fPoint vector0{m.v1.x - m.v0.x, m.v1.y - m.v0.y, m.v1.z - m.v0.z};
+            const fPoint vector1{m.v2.x - m.v0.x, m.v2.y - m.v0.y, m.v2.z - m.v0.z};
+            const fPoint outerProduct{
+                vector0.y * vector1.z - vector0.z * vector1.y,
+                vector0.z * vector1.x - vector0.x * vector1.z,
+                vector0.x * vector1.y - vector0.y * vector1.x};
+            const float distance = sqrtf(outerProduct.x * outerProduct.x + outerProduct.y * outerProduct.y + outerProduct.z * outerProduct.z);
+            norms.emplace_back(fPoint{outerProduct.x / distance, outerProduct.y / distance, outerProduct.z / distance});
+        }
+
+        delete[] normals;
+        normals = new fPoint[norms.size()];
+        memcpy(normals, norms.data(), norms.size() * sizeof(fPoint));
+    }
+    report("copies + per face division", Elapsed(start));
+    delete[] normals;
+
+    std::vector<fPoint> out(mesh.size());
+    size_t degenerate = 0;
+    for (const unsigned int threadCount : {1u, 0u})
+    {
+        start = Clock::now();
+        for (unsigned int r = 0; r < rounds; ++r)
+        {
+            degenerate = MarchingCube::CalculateFaceNormals(mesh.data(), mesh.size(), out.data(), threadCount);
+        }
+        report(threadCount ? "SIMD into buffer, 1 thread" : "SIMD into buffer, all", Elapsed(start));
+    }
+    printf("%zu faces without area\n", degenerate);
+}
+
+/** The phantom marched as every voxel type, the wider volumes are the 8 bit one scaled so the meshes are the same*/
+static void BenchVoxelTypes(const Dimension &dimension, const std::vector<uint8_t> &volume)
+{
+    const size_t pointCount = volume.size();
+    const double cells = static_cast<double>(dimension.width - 1) * (dimension.height - 1) * (dimension.depth - 1);
+    const unsigned int rounds = 5;
+
+    std::vector<uint16_t> wide(pointCount);
+    std::vector<int16_t> hounsfield(pointCount);
+    std::vector<float> real(pointCount);
+    for (size_t i = 0; i < pointCount; ++i)
+    {
+        wide[i] = static_cast<uint16_t>(volume[i] * 256);
+        hounsfield[i] = static_cast<int16_t>(volume[i] * 16 - 1024);
+        real[i] = volume[i] / 255.f;
+    }
+
+    auto bytesOf = [](const void *points, const size_t size)
+    {
+        const auto *bytes = static_cast<const uint8_t *>(points);
+        return std::vector<uint8_t>(bytes, bytes + size);
+    };
+
+    printf("%-12s %12s %12s %14s\n", "voxel type", "faces", "time(ms)", "Mcells/s");
+    auto bench = [&](const char *name, const std::vector<uint8_t> &bytes, const unsigned int voxelType, const float isoSurface)
+    {
+        MarchingCube mc(bytes, Dimension{dimension.width, dimension.height, dimension.depth, voxelType});
+        mc.MarchValue(isoSurface, 1);
+
+        const auto start = Clock::now();
+        for (unsigned int r = 0; r < rounds; ++r)
+        {
+            mc.MarchValue(isoSurface, 1);
+        }
+        const double ms = Elapsed(start) / rounds;
+
+        std::vector<fPoint> vertices;
+        std::vector<unsigned int> indices;
+        mc.GetCurrentIndexedMesh(vertices, indices);
+        printf("%-12s %12zu %12.1f %14.1f\n", name, indices.size() / 3, ms, cells / ms / 1000.0);
+    };
+
+    bench("uint8", volume, VOXEL_UINT8, 100);
+    bench("uint16", bytesOf(wide.data(), pointCount * sizeof(uint16_t)), VOXEL_UINT16, 100 * 256);
+    bench("int16", bytesOf(hounsfield.data(), pointCount * sizeof(int16_t)), VOXEL_INT16, 100 * 16 - 1024);
+    bench("float", bytesOf(real.data(), pointCount * sizeof(float)), VOXEL_FLOAT32, 100 / 255.f);
+}
+
+int main(int argc, char **argv)
+{
+    const std::vector<std::pair<std::string, std::function<void(const Dimension &, const std::vector<uint8_t> &)>>> benches = {
+        {"kernel", BenchKernel},
+        {"traversal", BenchTraversal},
+        {"bricks", BenchBricks},
+        {"spanspace", BenchSpanSpace},
+        {"stream", BenchStream},
+        {"sink", BenchSink},
+        {"writers", BenchWriters},
+        {"quantized", BenchQuantized},
+        {"multi", BenchMulti},
+        {"patch", BenchPatch},
+        {"chunks", BenchChunks},
+        {"normalize", BenchNormalize},
+        {"normals", BenchNormals},
+        {"facenormals", BenchFaceNormals},
+        {"voxeltypes", BenchVoxelTypes},
+    };
+
+    const std::string which = argc > 1 ? argv[1] : "all";
+    const unsigned int size = argc > 2 ? static_cast<unsigned int>(atoi(argv[2])) : 256;
+
+    const Dimension dimension{size, size, size, VOXEL_UINT8};
+    std::vector<uint8_t> volume;
+    MakePhantom(dimension, volume);
+    printf("Phantom volume %ux%ux%u\n", dimension.width, dimension.height, dimension.depth);
+
+    for (const auto &bench : benches)
+    {
+        if (which == "all" || which == bench.first)
+        {
+            printf("\n== %s ==\n", bench.first.c_str());
+            bench.second(dimension, volume);
+        }
+    }
+
+    return 0;
+}
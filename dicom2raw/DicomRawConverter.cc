@@ -7,6 +7,10 @@
 #include <vector>
 #include <fstream>
 #include <algorithm>
+#include <thread>
+#include <limits>
+#include <type_traits>
+#include <math.h>
 
 #include <gdcmReader.h>
 #include <gdcmImageReader.h>
@@ -22,6 +26,314 @@
 
 #include <opencv2/opencv.hpp>
 
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define D2R_SIMD_X86
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+    /** A window of 16 bit samples => (sample - low) * scale clamped to 0 .. 255 and rounded to the nearest*/
+    struct SampleWindow
+    {
+        float low;
+        float scale;
+    };
+
+    template <typename T>
+    inline void MinMaxScalar(const T *samples, const size_t begin, const size_t end, T &inOutMin, T &inOutMax)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            inOutMin = std::min(inOutMin, samples[i]);
+            inOutMax = std::max(inOutMax, samples[i]);
+        }
+    }
+
+    template <typename T>
+    inline void WindowScalar(const T *in, uint8_t *out, const size_t begin, const size_t end, const SampleWindow window)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const float value = std::min(std::max((static_cast<float>(in[i]) - window.low) * window.scale, 0.0f), 255.0f);
+            out[i] = static_cast<uint8_t>(static_cast<int>(value + 0.5f));
+        }
+    }
+
+#ifdef D2R_SIMD_X86
+    /** SSE2 has only the signed 16 bit min/max, uint16 samples are flipped into the int16 order by their top bit*/
+    template <typename T>
+    void MinMaxSSE2(const T *samples, const size_t begin, const size_t end, T &inOutMin, T &inOutMax)
+    {
+        const __m128i bias = _mm_set1_epi16(std::is_same<T, uint16_t>::value ? static_cast<short>(0x8000) : 0);
+        __m128i minVec = _mm_set1_epi16(0x7fff);
+        __m128i maxVec = _mm_set1_epi16(static_cast<short>(0x8000));
+
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8)
+        {
+            const __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(samples + i)), bias);
+            minVec = _mm_min_epi16(minVec, v);
+            maxVec = _mm_max_epi16(maxVec, v);
+        }
+
+        alignas(16) T mins[8];
+        alignas(16) T maxs[8];
+        _mm_store_si128(reinterpret_cast<__m128i *>(mins), _mm_xor_si128(minVec, bias));
+        _mm_store_si128(reinterpret_cast<__m128i *>(maxs), _mm_xor_si128(maxVec, bias));
+        for (unsigned int k = 0; k < 8; ++k)
+        {
+            inOutMin = std::min(inOutMin, mins[k]);
+            inOutMax = std::max(inOutMax, maxs[k]);
+        }
+        MinMaxScalar(samples, i, end, inOutMin, inOutMax);
+    }
+
+    /** 8 samples as int32, zero or sign extended by their type*/
+    inline void LoadWideSSE2(const uint16_t *samples, __m128i &outLow, __m128i &outHigh)
+    {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(samples));
+        outLow = _mm_unpacklo_epi16(v, _mm_setzero_si128());
+        outHigh = _mm_unpackhi_epi16(v, _mm_setzero_si128());
+    }
+
+    inline void LoadWideSSE2(const int16_t *samples, __m128i &outLow, __m128i &outHigh)
+    {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(samples));
+        outLow = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        outHigh = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+    }
+
+    /** The clamped value is never negative, so the truncation of value + 0.5 rounds it like the scalar window*/
+    inline __m128i WindowLanesSSE2(const __m128i wide, const __m128 low, const __m128 scale)
+    {
+        __m128 value = _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(wide), low), scale);
+        value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(255.0f));
+        return _mm_cvttps_epi32(_mm_add_ps(value, _mm_set1_ps(0.5f)));
+    }
+
+    /** SSE2 window, 16 samples per step*/
+    template <typename T>
+    void WindowSSE2(const T *in, uint8_t *out, const size_t begin, const size_t end, const SampleWindow window)
+    {
+        const __m128 low = _mm_set1_ps(window.low);
+        const __m128 scale = _mm_set1_ps(window.scale);
+
+        size_t i = begin;
+        for (; i + 16 <= end; i += 16)
+        {
+            __m128i a, b, c, d;
+            LoadWideSSE2(in + i, a, b);
+            LoadWideSSE2(in + i + 8, c, d);
+            const __m128i ab = _mm_packs_epi32(WindowLanesSSE2(a, low, scale), WindowLanesSSE2(b, low, scale));
+            const __m128i cd = _mm_packs_epi32(WindowLanesSSE2(c, low, scale), WindowLanesSSE2(d, low, scale));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_packus_epi16(ab, cd));
+        }
+        WindowScalar(in, out, i, end, window);
+    }
+
+#if defined(__GNUC__)
+#define D2R_SIMD_AVX2
+#define D2R_TARGET_AVX2 __attribute__((target("avx2")))
+
+    /** Checked once, the AVX2 kernels are only used on CPUs which support it*/
+    const bool isAVX2Supported = __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER)
+#define D2R_SIMD_AVX2
+#define D2R_TARGET_AVX2
+
+    /** MSVC emits AVX2 without a target flag, the CPU has to support it and the OS has to save the ymm registers*/
+    inline bool CheckAVX2Supported()
+    {
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+        {
+            return false;
+        }
+
+        __cpuid(info, 1);
+        const bool isOSXSave = (info[2] & (1 << 27)) != 0;
+        const bool isAVX = (info[2] & (1 << 28)) != 0;
+        if (!isOSXSave || !isAVX || (_xgetbv(0) & 6) != 6)
+        {
+            return false;
+        }
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    }
+
+    const bool isAVX2Supported = CheckAVX2Supported();
+#endif
+
+#ifdef D2R_SIMD_AVX2
+    D2R_TARGET_AVX2 inline __m256i MinAVX2(const __m256i a, const __m256i b, const uint16_t *)
+    {
+        return _mm256_min_epu16(a, b);
+    }
+
+    D2R_TARGET_AVX2 inline __m256i MinAVX2(const __m256i a, const __m256i b, const int16_t *)
+    {
+        return _mm256_min_epi16(a, b);
+    }
+
+    D2R_TARGET_AVX2 inline __m256i MaxAVX2(const __m256i a, const __m256i b, const uint16_t *)
+    {
+        return _mm256_max_epu16(a, b);
+    }
+
+    D2R_TARGET_AVX2 inline __m256i MaxAVX2(const __m256i a, const __m256i b, const int16_t *)
+    {
+        return _mm256_max_epi16(a, b);
+    }
+
+    /** AVX2 min/max, 16 samples per step*/
+    template <typename T>
+    D2R_TARGET_AVX2 void MinMaxAVX2(const T *samples, const size_t begin, const size_t end, T &inOutMin, T &inOutMax)
+    {
+        __m256i minVec = _mm256_set1_epi16(static_cast<short>(std::numeric_limits<T>::max()));
+        __m256i maxVec = _mm256_set1_epi16(static_cast<short>(std::numeric_limits<T>::lowest()));
+
+        size_t i = begin;
+        for (; i + 16 <= end; i += 16)
+        {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(samples + i));
+            minVec = MinAVX2(minVec, v, samples);
+            maxVec = MaxAVX2(maxVec, v, samples);
+        }
+
+        alignas(32) T mins[16];
+        alignas(32) T maxs[16];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(mins), minVec);
+        _mm256_store_si256(reinterpret_cast<__m256i *>(maxs), maxVec);
+        for (unsigned int k = 0; k < 16; ++k)
+        {
+            inOutMin = std::min(inOutMin, mins[k]);
+            inOutMax = std::max(inOutMax, maxs[k]);
+        }
+        MinMaxScalar(samples, i, end, inOutMin, inOutMax);
+    }
+
+    D2R_TARGET_AVX2 inline __m256i LoadWideAVX2(const uint16_t *samples)
+    {
+        return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(samples)));
+    }
+
+    D2R_TARGET_AVX2 inline __m256i LoadWideAVX2(const int16_t *samples)
+    {
+        return _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(samples)));
+    }
+
+    D2R_TARGET_AVX2 inline __m256i WindowLanesAVX2(const __m256i wide, const __m256 low, const __m256 scale)
+    {
+        __m256 value = _mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(wide), low), scale);
+        value = _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(255.0f));
+        return _mm256_cvttps_epi32(_mm256_add_ps(value, _mm256_set1_ps(0.5f)));
+    }
+
+    /**
+     * AVX2 window, 32 samples per step. The packs work per 128 bit lane and leave the dwords of 4 bytes
+     * in the order a0 b0 c0 d0 a1 b1 c1 d1, the permute puts them back in the order of the samples
+     */
+    template <typename T>
+    D2R_TARGET_AVX2 void WindowAVX2(const T *in, uint8_t *out, const size_t begin, const size_t end, const SampleWindow window)
+    {
+        const __m256 low = _mm256_set1_ps(window.low);
+        const __m256 scale = _mm256_set1_ps(window.scale);
+        const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+        size_t i = begin;
+        for (; i + 32 <= end; i += 32)
+        {
+            const __m256i ab = _mm256_packs_epi32(
+                WindowLanesAVX2(LoadWideAVX2(in + i), low, scale),
+                WindowLanesAVX2(LoadWideAVX2(in + i + 8), low, scale));
+            const __m256i cd = _mm256_packs_epi32(
+                WindowLanesAVX2(LoadWideAVX2(in + i + 16), low, scale),
+                WindowLanesAVX2(LoadWideAVX2(in + i + 24), low, scale));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_permutevar8x32_epi32(_mm256_packus_epi16(ab, cd), order));
+        }
+        WindowScalar(in, out, i, end, window);
+    }
+#endif
+#endif
+
+    template <typename T>
+    void MinMaxSamples(const T *samples, const size_t count, T &outMin, T &outMax)
+    {
+        outMin = std::numeric_limits<T>::max();
+        outMax = std::numeric_limits<T>::lowest();
+#if defined(D2R_SIMD_AVX2)
+        if (isAVX2Supported)
+        {
+            MinMaxAVX2(samples, 0, count, outMin, outMax);
+            return;
+        }
+#endif
+#if defined(D2R_SIMD_X86)
+        MinMaxSSE2(samples, 0, count, outMin, outMax);
+#else
+        MinMaxScalar(samples, 0, count, outMin, outMax);
+#endif
+    }
+
+    template <typename T>
+    void WindowSamples(const T *in, uint8_t *out, const size_t count, const SampleWindow window)
+    {
+#if defined(D2R_SIMD_AVX2)
+        if (isAVX2Supported)
+        {
+            WindowAVX2(in, out, 0, count, window);
+            return;
+        }
+#endif
+#if defined(D2R_SIMD_X86)
+        WindowSSE2(in, out, 0, count, window);
+#else
+        WindowScalar(in, out, 0, count, window);
+#endif
+    }
+
+    /** Min/max of 16 bit samples stored as the source type, int16 if the pixel representation is signed*/
+    void SampleRange(const unsigned short *samples, const size_t count, const unsigned int sourceType, float &outLow, float &outHigh)
+    {
+        if (sourceType == VOXEL_INT16)
+        {
+            int16_t minValue, maxValue;
+            MinMaxSamples(reinterpret_cast<const int16_t *>(samples), count, minValue, maxValue);
+            outLow = minValue;
+            outHigh = maxValue;
+            return;
+        }
+
+        uint16_t minValue, maxValue;
+        MinMaxSamples(reinterpret_cast<const uint16_t *>(samples), count, minValue, maxValue);
+        outLow = minValue;
+        outHigh = maxValue;
+    }
+
+    void WindowSlice(const unsigned short *samples, uint8_t *out, const size_t count, const unsigned int sourceType, const SampleWindow window)
+    {
+        if (sourceType == VOXEL_INT16)
+        {
+            WindowSamples(reinterpret_cast<const int16_t *>(samples), out, count, window);
+            return;
+        }
+        WindowSamples(reinterpret_cast<const uint16_t *>(samples), out, count, window);
+    }
+
+    /** The window from low to high in the unit of the stored samples, a window without width makes every sample 0*/
+    SampleWindow MakeWindow(const double low, const double high)
+    {
+        return SampleWindow{static_cast<float>(low), high != low ? static_cast<float>(255 / (high - low)) : 0.0f};
+    }
+}
+
 DicomRawConverter::DicomRawConverter() {}
 DicomRawConverter::DicomRawConverter(const std::string &directory, const std::string &filePatternString)
 {
@@ -42,7 +354,6 @@ DicomRawConverter::DicomRawConverter(const std::string &directory, const std::st
         }
     }
 
-    dicomSequential.resize(dicomSequentialNames.size());
     dimension.depth = static_cast<unsigned int>(dicomSequentialNames.size());
 }
 DicomRawConverter::DicomRawConverter(const std::vector<std::string> &inputPaths)
@@ -60,7 +371,6 @@ DicomRawConverter::DicomRawConverter(const std::vector<std::string> &inputPaths)
                 0));
     }
 
-    dicomSequential.resize(dicomSequentialNames.size());
     dimension.depth = static_cast<unsigned int>(dicomSequentialNames.size());
 }
 
@@ -101,112 +411,539 @@ void DicomRawConverter::SortFile(const std::string &sortPatternNumberString, con
         });
 }
 
-void DicomRawConverter::DecompressDicom(const unsigned int order, const bool isCV)
+/** Bytes of a point of the voxel types the converter makes*/
+static unsigned int VoxelBytes(const unsigned int voxelType)
 {
-    std::ifstream inFile(dicomSequentialNames[order].first, std::ios::binary);
-    gdcm::ImageReader reader;
-    reader.SetStream(inFile);
+    return voxelType == VOXEL_UINT8 ? 1 : 2;
+}
 
-    if (!reader.Read())
+/** OpenCV type of a slice of the voxel types the converter makes*/
+static int SliceMatType(const unsigned int voxelType)
+{
+    switch (voxelType)
     {
-        brokenLayer.emplace_back(order);
-        return;
+    case VOXEL_UINT16:
+        return CV_16UC1;
+    case VOXEL_INT16:
+        return CV_16SC1;
+    default:
+        return CV_8UC1;
     }
+}
 
-    auto &ds = reader.GetFile().GetDataSet();
-    auto &header = reader.GetFile().GetHeader();
-
-    const auto pixelDataTag = gdcm::Tag(0x7fe0, 0x0010);
-    const auto dataTransferTag = gdcm::Tag(0x0002, 0x0010);
+/** Rows, columns and samples of a slice, the type of the stored samples and the one the raw keeps them as*/
+struct SliceFormat
+{
+    unsigned int rows;
+    unsigned int cols;
+    unsigned int sourceType;
+    unsigned int voxelType;
+};
 
+/** Format of a slice by its data set, false if the raw cannot keep its samples*/
+static bool ReadSliceFormat(const gdcm::DataSet &ds, const bool isFullDepth, SliceFormat &outFormat)
+{
     gdcm::Attribute<0x0028, 0x0010> rowsAttr;
     gdcm::Attribute<0x0028, 0x0011> colsAttr;
     gdcm::Attribute<0x0028, 0x0100> bitsAllocatedAttr;
-    gdcm::Attribute<0x0028, 0x0101> bitsStoredAttr;
+    gdcm::Attribute<0x0028, 0x0103> pixelRepresentationAttr;
 
     rowsAttr.SetFromDataElement(ds.GetDataElement(rowsAttr.GetTag()));
     colsAttr.SetFromDataElement(ds.GetDataElement(colsAttr.GetTag()));
     bitsAllocatedAttr.SetFromDataElement(ds.GetDataElement(bitsAllocatedAttr.GetTag()));
+    pixelRepresentationAttr.SetFromDataElement(ds.GetDataElement(pixelRepresentationAttr.GetTag()));
 
     const unsigned int rows = rowsAttr.GetValue();
     const unsigned int cols = colsAttr.GetValue();
     const unsigned int bitsAllocated = bitsAllocatedAttr.GetValue();
 
-    if (bitsAllocated != 8 && bitsAllocated != 16)
+    if ((bitsAllocated != 8 && bitsAllocated != 16) || rows == 0 || cols == 0)
     {
-        brokenLayer.emplace_back(order);
-        return;
+        return false;
     }
 
-    if (order == 0)
+    /** 16 bit samples are int16 if the pixel representation is 1, full depth => they stay 16 bit in the raw*/
+    unsigned int sourceType = VOXEL_UINT8;
+    if (bitsAllocated == 16)
     {
-        dimension.width = rows;
-        dimension.height = cols;
+        sourceType = pixelRepresentationAttr.GetValue() == 1 ? VOXEL_INT16 : VOXEL_UINT16;
     }
 
-    auto &image = reader.GetImage();
-    unsigned long imgBufferLength = image.GetBufferLength();
+    outFormat = SliceFormat{rows, cols, sourceType, isFullDepth ? sourceType : VOXEL_UINT8};
+    return true;
+}
 
-    auto imgBuffer = std::make_unique<uint8_t[]>(imgBufferLength);
-    const bool isBufferGet = image.GetBuffer(reinterpret_cast<char *>(imgBuffer.get()));
+/** Rescale of the stored samples to the modality unit, Hounsfield for CT, slope 1 and intercept 0 if the slice has none*/
+static void ReadRescale(const gdcm::DataSet &ds, double &outSlope, double &outIntercept)
+{
+    gdcm::Attribute<0x0028, 0x1052> interceptAttr;
+    gdcm::Attribute<0x0028, 0x1053> slopeAttr;
+
+    outSlope = 1;
+    outIntercept = 0;
 
-    if (!isBufferGet)
+    if (ds.FindDataElement(slopeAttr.GetTag()))
     {
-        brokenLayer.emplace_back(order);
-        return;
+        slopeAttr.SetFromDataElement(ds.GetDataElement(slopeAttr.GetTag()));
+        if (slopeAttr.GetValue() != 0)
+        {
+            outSlope = slopeAttr.GetValue();
+        }
     }
 
-    if (bitsAllocated == 16)
+    if (ds.FindDataElement(interceptAttr.GetTag()))
+    {
+        interceptAttr.SetFromDataElement(ds.GetDataElement(interceptAttr.GetTag()));
+        outIntercept = interceptAttr.GetValue();
+    }
+}
+
+/**
+ * Window of a center and a width in the modality unit as the DICOM linear VOI LUT has it,
+ * center - 0.5 -+ (width - 1) / 2, taken back to the unit of the stored samples by the rescale
+ */
+static SampleWindow ModalityWindow(const gdcm::DataSet &ds, const double center, const double width)
+{
+    double slope, intercept;
+    ReadRescale(ds, slope, intercept);
+
+    const double low = center - 0.5 - (width - 1) / 2;
+    const double high = center - 0.5 + (width - 1) / 2;
+    return MakeWindow((low - intercept) / slope, (high - intercept) / slope);
+}
+
+/** Window of a slice by the modes which need only the slice itself, false if the slice has no window of the mode*/
+static bool MakeSliceWindow(
+    const gdcm::DataSet &ds,
+    const unsigned short *samples,
+    const size_t count,
+    const unsigned int sourceType,
+    const unsigned int windowMode,
+    const float windowCenter,
+    const float windowWidth,
+    SampleWindow &outWindow)
+{
+    switch (windowMode)
+    {
+    case WINDOW_DICOM:
+    {
+        gdcm::Attribute<0x0028, 0x1050> centerAttr;
+        gdcm::Attribute<0x0028, 0x1051> widthAttr;
+        if (!ds.FindDataElement(centerAttr.GetTag()) || !ds.FindDataElement(widthAttr.GetTag()))
+        {
+            return false;
+        }
+
+        centerAttr.SetFromDataElement(ds.GetDataElement(centerAttr.GetTag()));
+        widthAttr.SetFromDataElement(ds.GetDataElement(widthAttr.GetTag()));
+
+        /** The first window of the slice if it has several*/
+        if (centerAttr.GetNumberOfValues() == 0 || widthAttr.GetNumberOfValues() == 0 || widthAttr.GetValue(0) < 1)
+        {
+            return false;
+        }
+
+        outWindow = ModalityWindow(ds, centerAttr.GetValue(0), widthAttr.GetValue(0));
+        return true;
+    }
+    case WINDOW_HOUNSFIELD:
+        outWindow = ModalityWindow(ds, windowCenter, windowWidth);
+        return true;
+    default:
+    {
+        float low, high;
+        SampleRange(samples, count, sourceType, low, high);
+        outWindow = MakeWindow(low, high);
+        return true;
+    }
+    }
+}
+
+/** The OpenCV sharpening of a slice, in place*/
+static void FilterSlice(uint8_t *slice, const unsigned int rows, const unsigned int cols, const unsigned int voxelType)
+{
+    cv::Mat matImg(rows, cols, SliceMatType(voxelType), slice);
+    cv::Mat dstImg = matImg, filterDst;
+
+    auto morphKernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(1, 1));
+    cv::Mat laplacianKernel = (cv::Mat_<float>(3, 3) << 0, 1, 0, 1, -4, 1, 0, 1, 0);
+
+    cv::GaussianBlur(dstImg, dstImg, cv::Size(3, 3), 0);
+    cv::filter2D(dstImg, filterDst, -1, laplacianKernel);
+    cv::addWeighted(dstImg, 1.5, filterDst, -0.5, 0, dstImg);
+
+    cv::erode(dstImg, dstImg, morphKernel);
+
+    // cv::equalizeHist(matImg, dstImg);
+
+    /** The filters work in place on the slice, a copy back is only needed if OpenCV gave dstImg a buffer of its own*/
+    if (dstImg.data != slice)
+    {
+        memcpy(slice, dstImg.data, dstImg.total() * dstImg.elemSize());
+    }
+    matImg.release();
+    dstImg.release();
+    morphKernel.release();
+    laplacianKernel.release();
+}
+
+/** f(slice) for every slice, the threads take the next slice until none is left, 0 threads means one per hardware core*/
+template <typename F>
+static void ForEachSlice(const unsigned int sliceCount, const unsigned int inputThreadCount, F &&f)
+{
+    unsigned int threadCount = inputThreadCount;
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threadCount = std::max(1u, std::min(threadCount, sliceCount));
+
+    std::atomic<unsigned int> nextSlice{0};
+    auto worker = [&]()
+    {
+        for (unsigned int i = nextSlice++; i < sliceCount; i = nextSlice++)
+        {
+            f(i);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int i = 1; i < threadCount; ++i)
+    {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto &w : workers)
     {
-        auto shortBuffer = std::make_unique<unsigned short[]>(imgBufferLength / 2);
-        memcpy(shortBuffer.get(), reinterpret_cast<unsigned short *>(imgBuffer.get()), imgBufferLength);
+        w.join();
+    }
+}
+
+/** What the scan knows of a slice by its header only*/
+struct SliceHeader
+{
+    bool isRead;
+    SliceFormat format;
+    bool hasPosition;
+    double position[3];
+    bool hasOrientation;
+    double orientation[6];
+    bool hasInstanceNumber;
+    int instanceNumber;
+    double thickness;
+};
+
+/** true if the slice has the element and it has a value*/
+static bool HasElement(const gdcm::DataSet &ds, const gdcm::Tag &tag)
+{
+    return ds.FindDataElement(tag) && !ds.GetDataElement(tag).IsEmpty();
+}
+
+/** Reads the header of every slice up to the pixel data in parallel, nothing is decoded*/
+static void ScanSliceHeaders(
+    const std::vector<std::pair<std::string, unsigned int>> &names,
+    const bool isFullDepth,
+    const unsigned int threadCount,
+    std::vector<SliceHeader> &outHeaders)
+{
+    outHeaders.assign(names.size(), SliceHeader{});
 
-        auto maxElement = *std::max_element(shortBuffer.get(), shortBuffer.get() + imgBufferLength / 2);
-        auto minElement = *std::min_element(shortBuffer.get(), shortBuffer.get() + imgBufferLength / 2);
+    ForEachSlice(
+        static_cast<unsigned int>(names.size()),
+        threadCount,
+        [&](const unsigned int i)
+        {
+            auto &header = outHeaders[i];
 
-        auto convertedBuffer = std::make_unique<uint8_t[]>(imgBufferLength / 2);
+            std::ifstream inFile(names[i].first, std::ios::binary);
+            gdcm::Reader reader;
+            reader.SetStream(inFile);
 
-        std::transform(
-            shortBuffer.get(),
-            shortBuffer.get() + imgBufferLength / 2,
-            convertedBuffer.get(),
-            [&maxElement, &minElement](unsigned short u16) -> uint8_t
+            if (!reader.ReadUpToTag(gdcm::Tag(0x7fe0, 0x0010)))
             {
-                unsigned short resU16 = static_cast<float>((u16 - minElement) * 255) / static_cast<float>(maxElement - minElement);
-                return static_cast<uint8_t>(resU16);
-            });
-        imgBufferLength /= 2;
-        imgBuffer = std::move(convertedBuffer);
+                return;
+            }
+
+            const auto &ds = reader.GetFile().GetDataSet();
+            header.isRead = ReadSliceFormat(ds, isFullDepth, header.format);
+
+            gdcm::Attribute<0x0020, 0x0032> positionAttr;
+            if (HasElement(ds, positionAttr.GetTag()))
+            {
+                positionAttr.SetFromDataElement(ds.GetDataElement(positionAttr.GetTag()));
+                for (unsigned int k = 0; k < 3; ++k)
+                {
+                    header.position[k] = positionAttr.GetValue(k);
+                }
+                header.hasPosition = true;
+            }
+
+            gdcm::Attribute<0x0020, 0x0037> orientationAttr;
+            if (HasElement(ds, orientationAttr.GetTag()))
+            {
+                orientationAttr.SetFromDataElement(ds.GetDataElement(orientationAttr.GetTag()));
+                for (unsigned int k = 0; k < 6; ++k)
+                {
+                    header.orientation[k] = orientationAttr.GetValue(k);
+                }
+                header.hasOrientation = true;
+            }
+
+            gdcm::Attribute<0x0020, 0x0013> instanceNumberAttr;
+            if (HasElement(ds, instanceNumberAttr.GetTag()))
+            {
+                instanceNumberAttr.SetFromDataElement(ds.GetDataElement(instanceNumberAttr.GetTag()));
+                header.instanceNumber = instanceNumberAttr.GetValue();
+                header.hasInstanceNumber = true;
+            }
+
+            gdcm::Attribute<0x0018, 0x0050> thicknessAttr;
+            if (HasElement(ds, thicknessAttr.GetTag()))
+            {
+                thicknessAttr.SetFromDataElement(ds.GetDataElement(thicknessAttr.GetTag()));
+                header.thickness = thicknessAttr.GetValue();
+            }
+        });
+}
+
+/**
+ * Position of every slice along the patient axis, the normal of the image plane by the orientation of the first slice
+ * which has one, false if a slice has no position or no slice has an orientation
+ */
+static bool PatientAxisPositions(const std::vector<SliceHeader> &headers, std::vector<double> &outPositions)
+{
+    const auto oriented = std::find_if(
+        headers.begin(),
+        headers.end(),
+        [](const SliceHeader &header)
+        {
+            return header.hasOrientation;
+        });
+
+    if (oriented == headers.end())
+    {
+        return false;
     }
 
-    dicomSequential[order].clear();
-    dicomSequential[order].resize(imgBufferLength);
-    memcpy(dicomSequential[order].data(), imgBuffer.get(), imgBufferLength);
+    const double *row = oriented->orientation;
+    const double *col = oriented->orientation + 3;
+    const double normal[3] = {
+        row[1] * col[2] - row[2] * col[1],
+        row[2] * col[0] - row[0] * col[2],
+        row[0] * col[1] - row[1] * col[0]};
 
-    if (isCV)
+    outPositions.clear();
+    for (const auto &header : headers)
     {
-        cv::Mat matImg(dimension.width, dimension.height, CV_8UC1, dicomSequential[order].data());
-        cv::Mat dstImg = matImg, filterDst;
+        if (!header.hasPosition)
+        {
+            return false;
+        }
+        outPositions.emplace_back(
+            header.position[0] * normal[0] +
+            header.position[1] * normal[1] +
+            header.position[2] * normal[2]);
+    }
+    return true;
+}
 
-        auto morphKernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(1, 1));
-        cv::Mat laplacianKernel = (cv::Mat_<float>(3, 3) << 0, 1, 0, 1, -4, 1, 0, 1, 0);
+bool DicomRawConverter::SortFileByPosition(const unsigned int threadCount)
+{
+    std::vector<SliceHeader> headers;
+    ScanSliceHeaders(dicomSequentialNames, false, threadCount, headers);
 
-        cv::GaussianBlur(dstImg, dstImg, cv::Size(3, 3), 0);
-        cv::filter2D(dstImg, filterDst, -1, laplacianKernel);
-        cv::addWeighted(dstImg, 1.5, filterDst, -0.5, 0, dstImg);
+    /** By the position along the patient axis, by the instance number if a slice has no position*/
+    std::vector<double> keys;
+    if (!PatientAxisPositions(headers, keys))
+    {
+        keys.clear();
+        for (const auto &header : headers)
+        {
+            if (!header.hasInstanceNumber)
+            {
+                return false;
+            }
+            keys.emplace_back(header.instanceNumber);
+        }
+    }
 
-        cv::erode(dstImg, dstImg, morphKernel);
+    std::vector<unsigned int> order(dicomSequentialNames.size());
+    for (unsigned int i = 0; i < order.size(); ++i)
+    {
+        order[i] = i;
+    }
+    std::stable_sort(
+        order.begin(),
+        order.end(),
+        [&keys](const unsigned int a, const unsigned int b)
+        {
+            return keys[a] < keys[b];
+        });
 
-        // cv::equalizeHist(matImg, dstImg);
+    std::vector<std::pair<std::string, unsigned int>> sortedNames;
+    for (unsigned int i = 0; i < order.size(); ++i)
+    {
+        sortedNames.emplace_back(std::move(dicomSequentialNames[order[i]].first), i);
+    }
+    dicomSequentialNames = std::move(sortedNames);
+    return true;
+}
 
-        memcpy(dicomSequential[order].data(), dstImg.data, dstImg.total());
-        matImg.release();
-        dstImg.release();
-        morphKernel.release();
-        laplacianKernel.release();
+bool DicomRawConverter::ScanSeries(const bool isFullDepth, const unsigned int threadCount)
+{
+    std::vector<SliceHeader> headers;
+    ScanSliceHeaders(dicomSequentialNames, isFullDepth, threadCount, headers);
+
+    /** The first readable header gives the format of the raw*/
+    const auto first = std::find_if(
+        headers.begin(),
+        headers.end(),
+        [](const SliceHeader &header)
+        {
+            return header.isRead;
+        });
+
+    if (first == headers.end())
+    {
+        for (unsigned int d = 0; d < dimension.depth; ++d)
+        {
+            brokenLayer.emplace_back(d);
+        }
+        return false;
+    }
+
+    dimension.width = first->format.rows;
+    dimension.height = first->format.cols;
+    dimension.voxelType = first->format.voxelType;
+    sourceType = first->format.sourceType;
+    sliceSpacing = static_cast<float>(first->thickness);
+
+    std::vector<uint8_t> isBroken(dimension.depth, 0);
+    for (unsigned int d = 0; d < dimension.depth; ++d)
+    {
+        const auto &format = headers[d].format;
+        isBroken[d] = !headers[d].isRead ||
+                      format.rows != dimension.width ||
+                      format.cols != dimension.height ||
+                      format.sourceType != sourceType;
+    }
+
+    /**
+     * The steps between neighbouring slices along the patient axis are checked against their median, the second slice of a
+     * duplicate (no step), of a pair out of the order of the others (a step the other way) or after a gap (over 1.5 steps) is broken
+     */
+    std::vector<double> positions;
+    if (dimension.depth > 1 && PatientAxisPositions(headers, positions))
+    {
+        std::vector<double> steps(dimension.depth - 1);
+        for (unsigned int d = 0; d + 1 < dimension.depth; ++d)
+        {
+            steps[d] = positions[d + 1] - positions[d];
+        }
+
+        std::vector<double> sortedSteps(steps);
+        std::nth_element(sortedSteps.begin(), sortedSteps.begin() + sortedSteps.size() / 2, sortedSteps.end());
+        const double median = sortedSteps[sortedSteps.size() / 2];
+        const double spacing = fabs(median);
+
+        for (unsigned int d = 0; d + 1 < dimension.depth; ++d)
+        {
+            const double step = steps[d];
+            if (fabs(step) <= 0.1 * spacing || step * median < 0 || fabs(step) > 1.5 * spacing)
+            {
+                isBroken[d + 1] = 1;
+            }
+        }
+        sliceSpacing = static_cast<float>(spacing);
+    }
+
+    for (unsigned int d = 0; d < dimension.depth; ++d)
+    {
+        if (isBroken[d])
+        {
+            brokenLayer.emplace_back(d);
+        }
+    }
+    return brokenLayer.empty();
+}
+
+bool DicomRawConverter::DecompressDicom(const unsigned int order, const bool isCV, const bool isFullDepth, std::vector<unsigned short> &scratch)
+{
+    std::ifstream inFile(dicomSequentialNames[order].first, std::ios::binary);
+    gdcm::ImageReader reader;
+    reader.SetStream(inFile);
+
+    if (!reader.Read())
+    {
+        return false;
+    }
+
+    /** Every slice of the raw has the size and the sample type of the scanned one*/
+    const auto &ds = reader.GetFile().GetDataSet();
+    SliceFormat format;
+    if (!ReadSliceFormat(ds, isFullDepth, format) ||
+        format.rows != dimension.width ||
+        format.cols != dimension.height ||
+        format.sourceType != sourceType)
+    {
+        return false;
+    }
+
+    auto &image = reader.GetImage();
+    const size_t slicePoints = static_cast<size_t>(format.rows) * format.cols;
+    const size_t sliceBytes = slicePoints * VoxelBytes(format.voxelType);
+    uint8_t *slice = rawBuffer.data() + order * sliceBytes;
+
+    /**
+     * GDCM writes the samples straight into the slice of the raw. 16 bit samples windowed to 8 bit go through the scratch
+     * of the thread, or stay in the wide buffer until the window of the volume is known
+     */
+    if (format.sourceType != format.voxelType)
+    {
+        unsigned short *samples = nullptr;
+        if (windowMode == WINDOW_VOLUME_MINMAX)
+        {
+            samples = wideBuffer.data() + order * slicePoints;
+        }
+        else
+        {
+            scratch.resize(slicePoints);
+            samples = scratch.data();
+        }
+
+        if (image.GetBufferLength() != slicePoints * 2 || !image.GetBuffer(reinterpret_cast<char *>(samples)))
+        {
+            return false;
+        }
+
+        if (windowMode == WINDOW_VOLUME_MINMAX)
+        {
+            SampleRange(samples, slicePoints, format.sourceType, sliceRanges[order].first, sliceRanges[order].second);
+            return true;
+        }
+
+        SampleWindow window;
+        if (!MakeSliceWindow(ds, samples, slicePoints, format.sourceType, windowMode, windowCenter, windowWidth, window))
+        {
+            return false;
+        }
+        WindowSlice(samples, slice, slicePoints, format.sourceType, window);
+    }
+    else
+    {
+        if (image.GetBufferLength() != sliceBytes || !image.GetBuffer(reinterpret_cast<char *>(slice)))
+        {
+            return false;
+        }
+    }
+
+    if (isCV)
+    {
+        FilterSlice(slice, format.rows, format.cols, format.voxelType);
     }
 
     inFile.close();
+    return true;
 }
 
 void DicomRawConverter::GetDicomSequential(const unsigned int order, std::string &outName) const
@@ -216,16 +953,30 @@ void DicomRawConverter::GetDicomSequential(const unsigned int order, std::string
 
 void DicomRawConverter::GetDicomSequential(const unsigned int order, std::vector<uint8_t> &outBuffer) const
 {
-    outBuffer = std::vector<uint8_t>(dicomSequential[order].begin(), dicomSequential[order].end());
+    const uint8_t *slice = GetDecodedSlice(order);
+    if (slice == nullptr)
+    {
+        outBuffer.clear();
+        return;
+    }
+
+    outBuffer = std::vector<uint8_t>(slice, slice + GetSliceBytes());
 }
 
 void DicomRawConverter::ShowDicomSequential(const unsigned int order) const
 {
-    if (!dicomSequential.empty() && !dicomSequential[order].empty())
+    const uint8_t *slice = GetDecodedSlice(order);
+    if (slice != nullptr)
     {
-        std::vector<uint8_t> cvBuffer(dicomSequential[order].begin(), dicomSequential[order].end());
+        std::vector<uint8_t> cvBuffer(slice, slice + GetSliceBytes());
 
-        cv::Mat matImg(dimension.width, dimension.height, CV_8UC1, cvBuffer.data());
+        cv::Mat matImg(dimension.width, dimension.height, SliceMatType(dimension.voxelType), cvBuffer.data());
+
+        /** A 16 bit slice is shown stretched to 8 bit*/
+        if (dimension.voxelType != VOXEL_UINT8)
+        {
+            cv::normalize(matImg, matImg, 0, 255, cv::NORM_MINMAX, CV_8UC1);
+        }
 
         cv::namedWindow(dicomSequentialNames[order].first, cv::WINDOW_NORMAL);
         cv::resizeWindow(dicomSequentialNames[order].first, dimension.width, dimension.height);
@@ -237,8 +988,28 @@ void DicomRawConverter::ShowDicomSequential(const unsigned int order) const
     }
 }
 
+size_t DicomRawConverter::GetSliceBytes() const
+{
+    return static_cast<size_t>(dimension.width) * dimension.height * VoxelBytes(dimension.voxelType);
+}
+
+const uint8_t *DicomRawConverter::GetDecodedSlice(const unsigned int order) const
+{
+    if (order >= decodedLayers.size() || !decodedLayers[order] || rawBuffer.empty())
+    {
+        return nullptr;
+    }
+    return rawBuffer.data() + order * GetSliceBytes();
+}
+
 void DicomRawConverter::GetRawData(std::vector<uint8_t> &outBuffer) const
 {
+    /** The raw of a build with broken layers is not complete*/
+    if (!brokenLayer.empty())
+    {
+        outBuffer.clear();
+        return;
+    }
     outBuffer = std::vector<uint8_t>(rawBuffer.begin(), rawBuffer.end());
 }
 
@@ -253,39 +1024,117 @@ bool DicomRawConverter::Build()
 }
 
 bool DicomRawConverter::Build(const bool isCV)
+{
+    return Build(isCV, false);
+}
+
+bool DicomRawConverter::Build(const bool isCV, const bool isFullDepth)
+{
+    return Build(isCV, isFullDepth, 1);
+}
+
+bool DicomRawConverter::Build(const bool isCV, const bool isFullDepth, const unsigned int threadCount)
 {
     rawBuffer.clear();
-    for (unsigned int i = 0; i < dimension.depth; i++)
+    brokenLayer.clear();
+    decodedSlices = 0;
+    decodedLayers.assign(dimension.depth, 0);
+    dimension.width = 0;
+    dimension.height = 0;
+    dimension.voxelType = VOXEL_UINT8;
+    sliceSpacing = 0;
+
+    /**
+     * The headers are checked before any slice is decoded, the build fails fast on a slice which cannot be part of the raw.
+     * The raw is then allocated once by the scanned format and every slice is decoded into its place in it
+     */
+    if (!ScanSeries(isFullDepth, threadCount))
     {
-        DecompressDicom(i, isCV);
+        return false;
     }
+    rawBuffer.resize(GetSliceBytes() * dimension.depth);
 
-    if (!brokenLayer.empty())
+    /** The window of the volume needs the min/max of every slice first, the 16 bit samples wait in the wide buffer*/
+    const size_t slicePoints = static_cast<size_t>(dimension.width) * dimension.height;
+    const bool isVolumeWindow = sourceType != dimension.voxelType && windowMode == WINDOW_VOLUME_MINMAX;
+    if (isVolumeWindow)
     {
-        return false;
+        wideBuffer.resize(slicePoints * dimension.depth);
+        sliceRanges.assign(dimension.depth, std::pair<float, float>(0.0f, 0.0f));
     }
 
-    rawBuffer.resize(dimension.width * dimension.height * dimension.depth);
+    ForEachSlice(
+        dimension.depth,
+        threadCount,
+        [&](const unsigned int d)
+        {
+            thread_local std::vector<unsigned short> scratch;
+            decodedLayers[d] = DecompressDicom(d, isCV, isFullDepth, scratch) ? 1 : 0;
+            ++decodedSlices;
+        });
 
+    /** Collected in the order of the slices, the same for any thread count*/
     for (unsigned int d = 0; d < dimension.depth; ++d)
     {
-        auto &image = dicomSequential[d];
+        if (!decodedLayers[d])
+        {
+            brokenLayer.emplace_back(d);
+        }
+    }
 
-        for (unsigned int h = 0; h < dimension.height; ++h)
+    if (isVolumeWindow)
+    {
+        if (brokenLayer.empty())
         {
-            memcpy(
-                rawBuffer.data() + d * dimension.height * dimension.width + h * dimension.width,
-                image.data() + h * dimension.width,
-                dimension.width);
+            float low = sliceRanges[0].first, high = sliceRanges[0].second;
+            for (const auto &range : sliceRanges)
+            {
+                low = std::min(low, range.first);
+                high = std::max(high, range.second);
+            }
+
+            const SampleWindow window = MakeWindow(low, high);
+            ForEachSlice(
+                dimension.depth,
+                threadCount,
+                [&](const unsigned int d)
+                {
+                    uint8_t *slice = rawBuffer.data() + d * slicePoints;
+                    WindowSlice(wideBuffer.data() + d * slicePoints, slice, slicePoints, sourceType, window);
+                    if (isCV)
+                    {
+                        FilterSlice(slice, dimension.width, dimension.height, dimension.voxelType);
+                    }
+                });
         }
+
+        std::vector<unsigned short>().swap(wideBuffer);
+        std::vector<std::pair<float, float>>().swap(sliceRanges);
     }
 
-    return true;
+    return brokenLayer.empty();
+}
+
+float DicomRawConverter::GetSliceSpacing() const
+{
+    return sliceSpacing;
+}
+
+void DicomRawConverter::SetWindow(const unsigned int mode, const float center, const float width)
+{
+    windowMode = mode;
+    windowCenter = center;
+    windowWidth = width;
+}
+
+unsigned int DicomRawConverter::GetDecodedSlices() const
+{
+    return decodedSlices;
 }
 
 void DicomRawConverter::WriteToRawFile(const std::string &outFilename) const
 {
-    if (rawBuffer.empty())
+    if (rawBuffer.empty() || !brokenLayer.empty())
     {
         return;
     }
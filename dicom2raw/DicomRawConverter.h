@@ -7,6 +7,7 @@
 #include <vector>
 #include <memory>
 #include <utility>
+#include <atomic>
 
 class DicomRawConverter
 {
@@ -17,9 +18,39 @@ public:
     ~DicomRawConverter();
 
     void SortFile(const std::string &, const unsigned int resultOrder);
+
+    /**
+     * thread count (0 => one thread per hardware core), sorts the slices by their position along the patient axis read from
+     * the headers only, by the instance number if a slice has no position, false if neither orders every slice
+     */
+    bool SortFileByPosition(const unsigned int);
     bool Build();
     bool Build(const bool);
 
+    /**
+     * isCV, isFullDepth => true keeps the 16 bit samples as they are stored, uint16 or int16 by the pixel representation,
+     * instead of stretching every slice to 8 bit by its own min/max. The voxel type of the raw is in the dimension
+     */
+    bool Build(const bool, const bool);
+
+    /**
+     * isCV, isFullDepth, thread count (0 => one thread per hardware core), the slices are decoded in parallel,
+     * the raw and the broken layers are the same as the ones of a build by a thread
+     */
+    bool Build(const bool, const bool, const unsigned int);
+
+    /**
+     * WINDOW_* mode, center, width => how the 16 bit samples of a build which is not full depth become 8 bit.
+     * The center and the width are in Hounsfield units and only used by WINDOW_HOUNSFIELD
+     */
+    void SetWindow(const unsigned int, const float, const float);
+
+    /** Distance between the slices along the patient axis found by the last build, the slice thickness if they have no position*/
+    float GetSliceSpacing() const;
+
+    /** Slices decoded by the running or the last build, safe to call from another thread while Build runs*/
+    unsigned int GetDecodedSlices() const;
+
     void GetDicomSequential(const unsigned int, std::vector<uint8_t> &) const;
     void GetDicomSequential(const unsigned int, std::string &) const;
     void ShowDicomSequential(const unsigned int) const;
@@ -32,12 +63,41 @@ public:
     void GetBrokenLayer(std::vector<unsigned int> &) const;
 
 private:
-    Dimension dimension{0, 0, 0};
+    Dimension dimension{0, 0, 0, VOXEL_UINT8};
     std::vector<uint8_t> rawBuffer;
     std::vector<unsigned int> brokenLayer;
     std::vector<std::pair<std::string, unsigned int>> dicomSequentialNames;
-    std::vector<std::vector<uint8_t>> dicomSequential;
-    void DecompressDicom(const unsigned int, const bool);
+    std::atomic<unsigned int> decodedSlices{0};
+
+    unsigned int windowMode = WINDOW_SLICE_MINMAX;
+    float windowCenter = 0;
+    float windowWidth = 0;
+
+    /** VOXEL_* of the stored samples of the scanned slices, the raw keeps them as dimension.voxelType*/
+    unsigned int sourceType = VOXEL_UINT8;
+
+    /** The 16 bit samples and the min/max of every slice of a WINDOW_VOLUME_MINMAX build, only kept while it runs*/
+    std::vector<unsigned short> wideBuffer;
+    std::vector<std::pair<float, float>> sliceRanges;
+
+    /** 1 for a slice decoded into its place of the raw, a byte per slice so the threads of a build never share one*/
+    std::vector<uint8_t> decodedLayers;
+
+    float sliceSpacing = 0;
+
+    /**
+     * isFullDepth, thread count, reads every header up to the pixel data in parallel, sets the format of the raw by the first
+     * readable one and puts the slices which cannot be part of it in brokenLayer: unreadable, another format, a duplicate or a gap
+     */
+    bool ScanSeries(const bool, const unsigned int);
+
+    /** order, isCV, isFullDepth, scratch of the thread, decodes the slice straight into its place of the raw, false if it is broken*/
+    bool DecompressDicom(const unsigned int, const bool, const bool, std::vector<unsigned short> &);
+
+    size_t GetSliceBytes() const;
+
+    /** The slice in the raw, nullptr if it was not decoded*/
+    const uint8_t *GetDecodedSlice(const unsigned int) const;
 };
 
 #endif
\ No newline at end of file
@@ -40,10 +40,37 @@ void SortDicomFile(const ConvHandle handle, const char *sortNumberPattern, const
     convInstanceMapping[handle]->SortFile(sortNumberPattern, groupOrder);
 }
 
+int SortDicomFileByPosition(const ConvHandle handle, const unsigned int threadCount)
+{
+    return static_cast<int>(convInstanceMapping[handle]->SortFileByPosition(threadCount));
+}
+
 int Build(const ConvHandle handle, const int isCV)
 {
     return static_cast<int>(convInstanceMapping[handle]->Build(isCV));
 }
+
+int BuildFullDepth(const ConvHandle handle, const int isCV)
+{
+    return static_cast<int>(convInstanceMapping[handle]->Build(isCV, true));
+}
+
+int ParallelBuild(const ConvHandle handle, const int isCV, const int isFullDepth, const unsigned int threadCount)
+{
+    return static_cast<int>(convInstanceMapping[handle]->Build(isCV, isFullDepth, threadCount));
+}
+
+void SetDicomWindow(const ConvHandle handle, const unsigned int mode, const float center, const float width)
+{
+    convInstanceMapping[handle]->SetWindow(mode, center, width);
+}
+
+unsigned int GetDecodedSlices(const ConvHandle handle)
+{
+    /** find instead of operator[], the map is only read while another thread builds*/
+    const auto it = convInstanceMapping.find(handle);
+    return it == convInstanceMapping.end() ? 0 : it->second->GetDecodedSlices();
+}
 /** order number, outBuffer*/
 void GetDicomBufferSequential(const ConvHandle handle, const unsigned int order, char **outBuffer, unsigned int *bufSize)
 {
@@ -75,6 +102,7 @@ void GetRawDimension(const ConvHandle handle, Dimension *dimension)
     dimension->height = outDimension.height;
     dimension->width = outDimension.width;
     dimension->depth = outDimension.depth;
+    dimension->voxelType = outDimension.voxelType;
 }
 
 unsigned int GetDicomCounts(const ConvHandle handle)
@@ -82,6 +110,11 @@ unsigned int GetDicomCounts(const ConvHandle handle)
     return convInstanceMapping[handle]->GetDicomCounts();
 }
 
+float GetSliceSpacing(const ConvHandle handle)
+{
+    return convInstanceMapping[handle]->GetSliceSpacing();
+}
+
 void WriteToRawFile(const ConvHandle handle, const char *outputFilename)
 {
     convInstanceMapping[handle]->WriteToRawFile(outputFilename);
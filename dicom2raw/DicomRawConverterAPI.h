@@ -23,7 +23,17 @@ extern "C"
 
     /** sort number pattern, group order*/
     EXPORTD2RAPI void SortDicomFile(const ConvHandle, const char *, const unsigned int);
+    /** thread count (0 => one thread per hardware core), sorts by the position along the patient axis in the headers, by the instance number without one, returns 0 if neither orders every slice*/
+    EXPORTD2RAPI int SortDicomFileByPosition(const ConvHandle, const unsigned int);
     EXPORTD2RAPI int Build(const ConvHandle, const int);
+    /** isCV => as Build but the 16 bit samples are kept as they are stored, GetRawDimension tells their voxel type*/
+    EXPORTD2RAPI int BuildFullDepth(const ConvHandle, const int);
+    /** isCV, isFullDepth, thread count (0 => one thread per hardware core), the slices are decoded in parallel*/
+    EXPORTD2RAPI int ParallelBuild(const ConvHandle, const int, const int, const unsigned int);
+    /** WINDOW_* mode, center, width (Hounsfield units, WINDOW_HOUNSFIELD only) => how 16 bit samples are windowed by the builds which are not full depth*/
+    EXPORTD2RAPI void SetDicomWindow(const ConvHandle, const unsigned int, const float, const float);
+    /** Slices decoded by the running or the last build, may be polled from another thread while a build runs*/
+    EXPORTD2RAPI unsigned int GetDecodedSlices(const ConvHandle);
     /** order number, outBuffer*/
     EXPORTD2RAPI void GetDicomBufferSequential(const ConvHandle, const unsigned int, char **, unsigned int *);
     /** order number, outName*/
@@ -31,6 +41,8 @@ extern "C"
     EXPORTD2RAPI void ShowDicomSequential(const ConvHandle, const unsigned int);
     EXPORTD2RAPI void GetRawDimension(const ConvHandle, Dimension *);
     EXPORTD2RAPI unsigned int GetDicomCounts(const ConvHandle);
+    /** Distance between the slices along the patient axis found by the last build, the slice thickness if they have no position*/
+    EXPORTD2RAPI float GetSliceSpacing(const ConvHandle);
 
     EXPORTD2RAPI void WriteToRawFile(const ConvHandle, const char *);
     EXPORTD2RAPI void GetRawData(const ConvHandle, char **, unsigned int *);